@@ -6,6 +6,19 @@
 #include <thread>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -18,45 +31,48 @@ const double lambda2 = 2.79;
 const double lambda3 = 6.48;
 const int n = 3;  // Orden del derivador
 
-// Clase para el Derivador de Orden Superior
-class HighOrderDerivator {
+// Clase para el Derivador de Orden Superior. Real fija la precision del calculo
+// (double por defecto; float para comparar costo en el benchmark)
+template <class Real>
+class BasicHighOrderDerivator {
 private:
-    double z0, z1, z2, z3;
+    Real z0, z1, z2, z3;
     
     // Funcion phi segun la ecuacion del documento
-    double phi(int i, double error) {
-        double exponent = (double)(n - i) / (double)(n + 1);
-        double lambda_vals[] = {lambda0, lambda1, lambda2, lambda3};
-        double L_power = pow(L, (double)(i + 1) / (double)(n + 1));
+    Real phi(int i, Real error) {
+        Real exponent = (Real)(n - i) / (Real)(n + 1);
+        Real lambda_vals[] = {Real(lambda0), Real(lambda1), Real(lambda2), Real(lambda3)};
+        Real L_power = pow(Real(L), (Real)(i + 1) / (Real)(n + 1));
         
-        double sign_error = (error >= 0) ? 1.0 : -1.0;
+        Real sign_error = (error >= 0) ? Real(1) : Real(-1);
         
         return -lambda_vals[i] * L_power * pow(abs(error), exponent) * sign_error;
     }
     
 public:
-    HighOrderDerivator() : z0(0), z1(0), z2(0), z3(0) {}
+    BasicHighOrderDerivator() : z0(0), z1(0), z2(0), z3(0) {}
     
     // Actualizacion segun ecuaciones (2) del documento
-    void update(double f_ref) {
-        double error = z0 - f_ref;
+    void update(Real f_ref) {
+        const Real ts = Real(tau_s);
+        Real error = z0 - f_ref;
         
-        double phi0 = phi(0, error);
-        double phi1 = phi(1, error);
-        double phi2 = phi(2, error);
-        double phi3 = phi(3, error);
+        Real phi0 = phi(0, error);
+        Real phi1 = phi(1, error);
+        Real phi2 = phi(2, error);
+        Real phi3 = phi(3, error);
         
         // Ecuaciones (2) exactas del documento
-        double z0_new = z0 + tau_s * phi0 + tau_s * z1 + 
-                        (tau_s * tau_s / 2.0) * z2 + 
-                        (tau_s * tau_s * tau_s / 6.0) * z3;
+        Real z0_new = z0 + ts * phi0 + ts * z1 + 
+                      (ts * ts / Real(2)) * z2 + 
+                      (ts * ts * ts / Real(6)) * z3;
                         
-        double z1_new = z1 + tau_s * phi1 + tau_s * z2 + 
-                        (tau_s * tau_s / 2.0) * z3;
+        Real z1_new = z1 + ts * phi1 + ts * z2 + 
+                      (ts * ts / Real(2)) * z3;
                         
-        double z2_new = z2 + tau_s * phi2 + tau_s * z3;
+        Real z2_new = z2 + ts * phi2 + ts * z3;
         
-        double z3_new = z3 + tau_s * phi3;
+        Real z3_new = z3 + ts * phi3;
         
         z0 = z0_new;
         z1 = z1_new;
@@ -64,121 +80,1428 @@ public:
         z3 = z3_new;
     }
     
-    double getZ0() const { return z0; }  // Seguimiento de f0
-    double getZ1() const { return z1; }  // Primera derivada
-    double getZ2() const { return z2; }  // Segunda derivada
-    double getZ3() const { return z3; }  // Tercera derivada
+    Real getZ0() const { return z0; }  // Seguimiento de f0
+    Real getZ1() const { return z1; }  // Primera derivada
+    Real getZ2() const { return z2; }  // Segunda derivada
+    Real getZ3() const { return z3; }  // Tercera derivada
+    
+    void saveState(Real* z) const {
+        z[0] = z0; z[1] = z1; z[2] = z2; z[3] = z3;
+    }
+    
+    void loadState(const Real* z) {
+        z0 = z[0]; z1 = z[1]; z2 = z[2]; z3 = z[3];
+    }
+    
+    void reset() {
+        z0 = z1 = z2 = z3 = 0;
+    }
+};
+
+typedef BasicHighOrderDerivator<double> HighOrderDerivator;
+
+// Sistema de ecuaciones diferenciales x_punto = f(t, x) que pueden avanzar los integradores
+class OdeSystem {
+public:
+    virtual ~OdeSystem() {}
+    
+    virtual int dimension() const = 0;
+    virtual void derivative(double t, const double* x, double* dxdt) const = 0;
+    
+    // Jacobiano df/dx (dimension x dimension, orden por filas). Retorna false si el
+    // sistema no lo provee; en ese caso el integrador lo aproxima por diferencias finitas
+    virtual bool jacobian(double t, const double* x, double* J) const {
+        (void)t; (void)x; (void)J;
+        return false;
+    }
+};
+
+// Interfaz comun de integracion: avanza el estado x desde t0 hasta t1 y contabiliza
+// evaluaciones de f y del jacobiano para comparar el costo de cada metodo
+class Integrator {
+protected:
+    long f_evals;
+    long j_evals;
+    long accepted_steps;
+    long rejected_steps;
+    
+    void eval(const OdeSystem& sys, double t, const double* x, double* dxdt) {
+        f_evals++;
+        sys.derivative(t, x, dxdt);
+    }
+    
+public:
+    Integrator() : f_evals(0), j_evals(0), accepted_steps(0), rejected_steps(0) {}
+    virtual ~Integrator() {}
+    
+    virtual const char* name() const = 0;
+    virtual void advance(const OdeSystem& sys, double t0, double t1, double* x) = 0;
+    
+    long functionEvaluations() const { return f_evals; }
+    long jacobianEvaluations() const { return j_evals; }
+    long acceptedSteps() const { return accepted_steps; }
+    long rejectedSteps() const { return rejected_steps; }
+    
+    // Estado interno que condiciona los pasos siguientes (paso adaptativo), para checkpoints
+    virtual double stepSizeHint() const { return 0.0; }
+    virtual void setStepSizeHint(double hint) { (void)hint; }
+    
+    void resetCounters() {
+        f_evals = j_evals = accepted_steps = rejected_steps = 0;
+    }
+};
+
+// Runge-Kutta clasico de 4 orden con un numero fijo de subpasos por intervalo
+class RK4Integrator : public Integrator {
+private:
+    int substeps;
+    vector<double> k1, k2, k3, k4, x_temp;
+    
+public:
+    explicit RK4Integrator(int substeps_ = 1) : substeps(max(1, substeps_)) {}
+    
+    const char* name() const { return "Runge-Kutta 4 orden (paso fijo)"; }
+    
+    void advance(const OdeSystem& sys, double t0, double t1, double* x) {
+        int dim = sys.dimension();
+        k1.resize(dim); k2.resize(dim); k3.resize(dim); k4.resize(dim); x_temp.resize(dim);
+        
+        double h = (t1 - t0) / substeps;
+        for (int s = 0; s < substeps; s++) {
+            double t = t0 + s * h;
+            
+            eval(sys, t, x, &k1[0]);
+            for (int i = 0; i < dim; i++) x_temp[i] = x[i] + 0.5 * h * k1[i];
+            eval(sys, t + 0.5 * h, &x_temp[0], &k2[0]);
+            for (int i = 0; i < dim; i++) x_temp[i] = x[i] + 0.5 * h * k2[i];
+            eval(sys, t + 0.5 * h, &x_temp[0], &k3[0]);
+            for (int i = 0; i < dim; i++) x_temp[i] = x[i] + h * k3[i];
+            eval(sys, t + h, &x_temp[0], &k4[0]);
+            
+            for (int i = 0; i < dim; i++) {
+                x[i] += (h / 6.0) * (k1[i] + 2 * k2[i] + 2 * k3[i] + k4[i]);
+            }
+            accepted_steps++;
+        }
+    }
+};
+
+// Dormand-Prince 5(4) con control de error y salida densa de 4 orden (Hairer, DOPRI5).
+// El paso se adapta a la tolerancia y se conserva entre llamadas; advance() termina
+// exactamente en t1 porque la entrada de la planta cambia en cada instante de muestreo.
+// integrateDense() avanza con el paso natural del metodo e interpola los estados en
+// los instantes de muestreo, util para sistemas con entrada continua.
+class DormandPrince54 : public Integrator {
+private:
+    double rtol, atol;
+    double h;  // Ultimo paso aceptado (0 = estimar)
+    
+    vector<double> k1, k2, k3, k4, k5, k6, k7, x_temp, x_new, x_err;
+    vector<double> r1, r2, r3, r4, r5;  // Coeficientes de salida densa
+    bool k1_valid;                      // FSAL: k7 del paso anterior es k1 del siguiente
+    
+    void resize(int dim) {
+        if ((int)k1.size() == dim) return;
+        k1.resize(dim); k2.resize(dim); k3.resize(dim); k4.resize(dim);
+        k5.resize(dim); k6.resize(dim); k7.resize(dim);
+        x_temp.resize(dim); x_new.resize(dim); x_err.resize(dim);
+        r1.resize(dim); r2.resize(dim); r3.resize(dim); r4.resize(dim); r5.resize(dim);
+        k1_valid = false;
+    }
+    
+    // Intenta un paso de tamano hs desde (t, x); retorna la norma del error escalada
+    double tryStep(const OdeSystem& sys, double t, const double* x, double hs) {
+        int dim = sys.dimension();
+        if (!k1_valid) {
+            eval(sys, t, x, &k1[0]);
+            k1_valid = true;
+        }
+        
+        for (int i = 0; i < dim; i++) x_temp[i] = x[i] + hs * (1.0 / 5.0) * k1[i];
+        eval(sys, t + hs / 5.0, &x_temp[0], &k2[0]);
+        for (int i = 0; i < dim; i++) {
+            x_temp[i] = x[i] + hs * (3.0 / 40.0 * k1[i] + 9.0 / 40.0 * k2[i]);
+        }
+        eval(sys, t + 3.0 * hs / 10.0, &x_temp[0], &k3[0]);
+        for (int i = 0; i < dim; i++) {
+            x_temp[i] = x[i] + hs * (44.0 / 45.0 * k1[i] - 56.0 / 15.0 * k2[i] + 32.0 / 9.0 * k3[i]);
+        }
+        eval(sys, t + 4.0 * hs / 5.0, &x_temp[0], &k4[0]);
+        for (int i = 0; i < dim; i++) {
+            x_temp[i] = x[i] + hs * (19372.0 / 6561.0 * k1[i] - 25360.0 / 2187.0 * k2[i] +
+                                     64448.0 / 6561.0 * k3[i] - 212.0 / 729.0 * k4[i]);
+        }
+        eval(sys, t + 8.0 * hs / 9.0, &x_temp[0], &k5[0]);
+        for (int i = 0; i < dim; i++) {
+            x_temp[i] = x[i] + hs * (9017.0 / 3168.0 * k1[i] - 355.0 / 33.0 * k2[i] +
+                                     46732.0 / 5247.0 * k3[i] + 49.0 / 176.0 * k4[i] -
+                                     5103.0 / 18656.0 * k5[i]);
+        }
+        eval(sys, t + hs, &x_temp[0], &k6[0]);
+        for (int i = 0; i < dim; i++) {
+            x_new[i] = x[i] + hs * (35.0 / 384.0 * k1[i] + 500.0 / 1113.0 * k3[i] +
+                                    125.0 / 192.0 * k4[i] - 2187.0 / 6784.0 * k5[i] +
+                                    11.0 / 84.0 * k6[i]);
+        }
+        eval(sys, t + hs, &x_new[0], &k7[0]);
+        
+        // Error = diferencia entre las soluciones de orden 5 y 4
+        double err = 0.0;
+        for (int i = 0; i < dim; i++) {
+            x_err[i] = hs * (71.0 / 57600.0 * k1[i] - 71.0 / 16695.0 * k3[i] +
+                             71.0 / 1920.0 * k4[i] - 17253.0 / 339200.0 * k5[i] +
+                             22.0 / 525.0 * k6[i] - 1.0 / 40.0 * k7[i]);
+            double sc = atol + rtol * max(fabs(x[i]), fabs(x_new[i]));
+            err += (x_err[i] / sc) * (x_err[i] / sc);
+        }
+        return sqrt(err / dim);
+    }
+    
+    // Prepara la interpolacion sobre el paso [t, t + hs] recien aceptado
+    void prepareDense(const double* x, double hs, int dim) {
+        const double d1 = -12715105075.0 / 11282082432.0;
+        const double d3 = 87487479700.0 / 32700410799.0;
+        const double d4 = -10690763975.0 / 1880347072.0;
+        const double d5 = 701980252875.0 / 199316789632.0;
+        const double d6 = -1453857185.0 / 822651844.0;
+        const double d7 = 69997945.0 / 29380423.0;
+        
+        for (int i = 0; i < dim; i++) {
+            double ydiff = x_new[i] - x[i];
+            double bspl = hs * k1[i] - ydiff;
+            r1[i] = x[i];
+            r2[i] = ydiff;
+            r3[i] = bspl;
+            r4[i] = ydiff - hs * k7[i] - bspl;
+            r5[i] = hs * (d1 * k1[i] + d3 * k3[i] + d4 * k4[i] + d5 * k5[i] + d6 * k6[i] + d7 * k7[i]);
+        }
+    }
+    
+    // Estado interpolado en la fraccion theta del ultimo paso aceptado
+    void interpolate(double theta, double* out, int dim) const {
+        double theta1 = 1.0 - theta;
+        for (int i = 0; i < dim; i++) {
+            out[i] = r1[i] + theta * (r2[i] + theta1 * (r3[i] + theta * (r4[i] + theta1 * r5[i])));
+        }
+    }
+    
+    // Factor de cambio del paso segun el error (controlador estandar con limites)
+    static double stepFactor(double err) {
+        if (err == 0.0) return 5.0;
+        return min(5.0, max(0.2, 0.9 * pow(err, -0.2)));
+    }
+    
+    // Un paso aceptado de a lo sumo h_max; actualiza x y retorna el paso dado
+    double acceptedStep(const OdeSystem& sys, double t, double* x, double h_max) {
+        int dim = sys.dimension();
+        if (h <= 0.0) h = h_max;
+        
+        while (true) {
+            double hs = min(h, h_max);
+            double err = tryStep(sys, t, x, hs);
+            if (err <= 1.0) {
+                prepareDense(x, hs, dim);
+                for (int i = 0; i < dim; i++) {
+                    x[i] = x_new[i];
+                    k1[i] = k7[i];
+                }
+                // Un paso recortado por h_max no debe reducir el paso natural
+                double h_next = hs * stepFactor(err);
+                h = (hs < h) ? max(h, h_next) : h_next;
+                accepted_steps++;
+                return hs;
+            }
+            h = hs * stepFactor(err);
+            rejected_steps++;
+        }
+    }
+    
+public:
+    DormandPrince54(double rtol_ = 1e-6, double atol_ = 1e-9)
+        : rtol(rtol_), atol(atol_), h(0.0), k1_valid(false) {}
+    
+    const char* name() const { return "Dormand-Prince 5(4) (paso adaptativo)"; }
+    
+    double stepSizeHint() const { return h; }
+    void setStepSizeHint(double hint) { h = hint; }
+    
+    void advance(const OdeSystem& sys, double t0, double t1, double* x) {
+        resize(sys.dimension());
+        // La entrada pudo cambiar desde la ultima llamada: k1 debe recalcularse
+        k1_valid = false;
+        
+        double t = t0;
+        while (t1 - t > 1e-12 * max(1.0, fabs(t1))) {
+            t += acceptedStep(sys, t, x, t1 - t);
+        }
+    }
+    
+    // Integra desde t0 y escribe en out (count x dimension) los estados interpolados en
+    // los instantes crecientes sample_times[0..count-1]. Al terminar, x queda en el ultimo.
+    void integrateDense(const OdeSystem& sys, double t0, double* x,
+                        const double* sample_times, int count, double* out) {
+        int dim = sys.dimension();
+        resize(dim);
+        k1_valid = false;
+        if (count <= 0) return;
+        
+        double t = t0;
+        double t_end = sample_times[count - 1];
+        int next = 0;
+        while (next < count) {
+            while (next < count && sample_times[next] <= t) {
+                for (int i = 0; i < dim; i++) out[next * dim + i] = x[i];
+                next++;
+            }
+            if (next >= count) break;
+            
+            double t_old = t;
+            double hs = acceptedStep(sys, t, x, t_end - t);
+            t = (t_end - (t_old + hs) <= 1e-12 * max(1.0, fabs(t_end))) ? t_end : t_old + hs;
+            
+            while (next < count && sample_times[next] < t) {
+                interpolate((sample_times[next] - t_old) / hs, &out[next * dim], dim);
+                next++;
+            }
+        }
+    }
+};
+
+// TR-BDF2 (Bank et al., gamma = 2 - sqrt(2)): etapa trapezoidal hasta t + gamma*h seguida
+// de BDF2. Es L-estable, apto para modelos rigidos. Ambas etapas usan la misma matriz
+// de iteracion (I - d*h*J) con d = gamma/2, por lo que se factoriza una vez por paso.
+class TRBDF2Integrator : public Integrator {
+private:
+    int substeps;
+    int max_newton;
+    double newton_tol;
+    
+    vector<double> J, M, f0, fz, rhs, z, x_gamma, delta;
+    vector<int> pivots;
+    
+    // Factorizacion LU con pivoteo parcial de M (dim x dim) en sitio
+    bool factor(int dim) {
+        for (int k = 0; k < dim; k++) {
+            int p = k;
+            for (int i = k + 1; i < dim; i++) {
+                if (fabs(M[i * dim + k]) > fabs(M[p * dim + k])) p = i;
+            }
+            pivots[k] = p;
+            if (M[p * dim + k] == 0.0) return false;
+            if (p != k) {
+                for (int j = 0; j < dim; j++) swap(M[k * dim + j], M[p * dim + j]);
+            }
+            for (int i = k + 1; i < dim; i++) {
+                double m = M[i * dim + k] / M[k * dim + k];
+                M[i * dim + k] = m;
+                for (int j = k + 1; j < dim; j++) M[i * dim + j] -= m * M[k * dim + j];
+            }
+        }
+        return true;
+    }
+    
+    void solve(double* b, int dim) const {
+        for (int k = 0; k < dim; k++) {
+            swap(b[k], b[pivots[k]]);
+            for (int i = k + 1; i < dim; i++) b[i] -= M[i * dim + k] * b[k];
+        }
+        for (int i = dim - 1; i >= 0; i--) {
+            for (int j = i + 1; j < dim; j++) b[i] -= M[i * dim + j] * b[j];
+            b[i] /= M[i * dim + i];
+        }
+    }
+    
+    void computeJacobian(const OdeSystem& sys, double t, const double* x, int dim) {
+        j_evals++;
+        if (sys.jacobian(t, x, &J[0])) return;
+        
+        // Diferencias finitas hacia adelante (dim evaluaciones adicionales de f)
+        eval(sys, t, x, &fz[0]);
+        for (int j = 0; j < dim; j++) {
+            double hj = 1e-7 * max(1.0, fabs(x[j]));
+            for (int i = 0; i < dim; i++) z[i] = x[i];
+            z[j] += hj;
+            eval(sys, t, &z[0], &delta[0]);
+            for (int i = 0; i < dim; i++) J[i * dim + j] = (delta[i] - fz[i]) / hj;
+        }
+    }
+    
+    // Resuelve z - dh*f(t, z) = rhs por Newton partiendo de la estimacion en z
+    void newton(const OdeSystem& sys, double t, double dh, int dim) {
+        for (int it = 0; it < max_newton; it++) {
+            eval(sys, t, &z[0], &fz[0]);
+            double norm_delta = 0.0, norm_z = 0.0;
+            for (int i = 0; i < dim; i++) delta[i] = rhs[i] - z[i] + dh * fz[i];
+            solve(&delta[0], dim);
+            for (int i = 0; i < dim; i++) {
+                z[i] += delta[i];
+                norm_delta = max(norm_delta, fabs(delta[i]));
+                norm_z = max(norm_z, fabs(z[i]));
+            }
+            if (norm_delta <= newton_tol * (1.0 + norm_z)) break;
+        }
+    }
+    
+public:
+    explicit TRBDF2Integrator(int substeps_ = 1, double newton_tol_ = 1e-10, int max_newton_ = 8)
+        : substeps(max(1, substeps_)), max_newton(max_newton_), newton_tol(newton_tol_) {}
+    
+    const char* name() const { return "TR-BDF2 implicito (paso fijo)"; }
+    
+    void advance(const OdeSystem& sys, double t0, double t1, double* x) {
+        const double gamma = 2.0 - sqrt(2.0);
+        const double d = gamma / 2.0;
+        int dim = sys.dimension();
+        J.resize(dim * dim); M.resize(dim * dim); pivots.resize(dim);
+        f0.resize(dim); fz.resize(dim); rhs.resize(dim); z.resize(dim);
+        x_gamma.resize(dim); delta.resize(dim);
+        
+        double h = (t1 - t0) / substeps;
+        for (int s = 0; s < substeps; s++) {
+            double t = t0 + s * h;
+            
+            computeJacobian(sys, t, x, dim);
+            for (int i = 0; i < dim; i++) {
+                for (int j = 0; j < dim; j++) {
+                    M[i * dim + j] = (i == j ? 1.0 : 0.0) - d * h * J[i * dim + j];
+                }
+            }
+            if (!factor(dim)) {
+                throw runtime_error("TR-BDF2: matriz de iteracion singular");
+            }
+            
+            // Etapa 1 (trapecio): z - d*h*f(z) = x + d*h*f(x)
+            eval(sys, t, x, &f0[0]);
+            for (int i = 0; i < dim; i++) {
+                rhs[i] = x[i] + d * h * f0[i];
+                z[i] = x[i] + gamma * h * f0[i];
+            }
+            newton(sys, t + gamma * h, d * h, dim);
+            
+            // Etapa 2 (BDF2): z - d*h*f(z) = (x_gamma - (1-gamma)^2 x) / (gamma (2-gamma))
+            double c = 1.0 / (gamma * (2.0 - gamma));
+            for (int i = 0; i < dim; i++) {
+                x_gamma[i] = z[i];
+                rhs[i] = c * (x_gamma[i] - (1.0 - gamma) * (1.0 - gamma) * x[i]);
+                z[i] = x_gamma[i] + (1.0 - gamma) * (x_gamma[i] - x[i]) / gamma;
+            }
+            newton(sys, t + h, d * h, dim);
+            
+            for (int i = 0; i < dim; i++) x[i] = z[i];
+            accepted_steps++;
+        }
+    }
+};
+
+// Orden maximo soportado para modelos de planta
+const int MAX_PLANT_ORDER = 20;
+
+// Planta LTI generica de orden N en espacio de estados:
+//   x_punto = Ax + Bu,  y = Cx + Du
+// Como la entrada se mantiene constante durante cada periodo de muestreo, un paso
+// RK4 sobre un sistema lineal equivale exactamente a x[k+1] = Ad x[k] + Bd u[k] con
+//   Ad = I + hA + (hA)^2/2 + (hA)^3/6 + (hA)^4/24
+//   Bd = h (I + hA/2 + (hA)^2/6 + (hA)^3/24) B
+// Ad y Bd se calculan una sola vez, asi cada muestra cuesta solo un producto
+// matriz-vector de N x N con dimensiones conocidas en compilacion. Con setIntegrator()
+// el modelo continuo se avanza con cualquier Integrator (p. ej. para modelos rigidos).
+// Real fija la precision del kernel discretizado; el modelo continuo es siempre double.
+template <int N, class Real = double>
+class LTIPlant : public OdeSystem {
+    static_assert(N >= 1 && N <= MAX_PLANT_ORDER, "Orden de planta fuera de rango");
+    
+protected:
+    // Modelo continuo
+    double A[N][N];
+    double B[N];
+    Real C[N];
+    Real D;
+    
+    // Modelo discretizado (RK4 con paso tau_s)
+    Real Ad[N][N];
+    Real Bd[N];
+    
+    // Estados
+    Real x[N];
+    Real u_prev;
+    
+    // Integrador externo opcional (no propietario); nullptr = modelo discretizado
+    Integrator* integrator;
+    double u_hold;  // Entrada mantenida durante el paso del integrador
+    
+    // P = I + s * M * Q   (M, Q de N x N)
+    static void identityPlusScaledProduct(double P[N][N], double s,
+                                          const double M[N][N], const double Q[N][N]) {
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                double sum = 0.0;
+                for (int k = 0; k < N; k++) sum += M[i][k] * Q[k][j];
+                P[i][j] = (i == j ? 1.0 : 0.0) + s * sum;
+            }
+        }
+    }
+    
+    // Calcula Ad y Bd por Horner: Ad = I + M(I + M/2(I + M/3(I + M/4))), M = hA
+    void discretize() {
+        double M[N][N], S[N][N], T[N][N], I[N][N], P[N][N];
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                M[i][j] = tau_s * A[i][j];
+                I[i][j] = (i == j) ? 1.0 : 0.0;
+            }
+        }
+        
+        identityPlusScaledProduct(T, 1.0 / 4.0, M, I);  // I + M/4
+        identityPlusScaledProduct(S, 1.0 / 3.0, M, T);  // I + M/3 (I + M/4)
+        identityPlusScaledProduct(T, 1.0 / 2.0, M, S);  // I + M/2 (...)
+        identityPlusScaledProduct(P, 1.0, M, T);        // I + M (...)
+        
+        for (int i = 0; i < N; i++) {
+            double sum = 0.0;
+            for (int k = 0; k < N; k++) {
+                sum += T[i][k] * B[k];
+                Ad[i][k] = Real(P[i][k]);
+            }
+            Bd[i] = Real(tau_s * sum);
+        }
+    }
+    
+public:
+    // Construccion desde espacio de estados (A en orden por filas, N x N)
+    LTIPlant(const vector<double>& A_, const vector<double>& B_,
+             const vector<double>& C_, double D_) {
+        if ((int)A_.size() != N * N || (int)B_.size() != N || (int)C_.size() != N) {
+            throw invalid_argument("Dimensiones de (A, B, C) incompatibles con el orden de la planta");
+        }
+        
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                A[i][j] = A_[i * N + j];
+            }
+            B[i] = B_[i];
+            C[i] = Real(C_[i]);
+        }
+        D = Real(D_);
+        integrator = nullptr;
+        u_hold = 0.0;
+        
+        discretize();
+        reset();
+    }
+    
+    // Construccion desde funcion de transferencia propia num(s)/den(s), coeficientes
+    // en potencias descendentes de s. Se usa la forma canonica controlable:
+    //   dx_i/dt = x_{i+1}  (i < N-1)
+    //   dx_{N-1}/dt = -a_N x_0 - ... - a_1 x_{N-1} + u
+    //   y = sum (b_{N-i} - a_{N-i} b_0) x_i + b_0 u
+    LTIPlant(const vector<double>& num, const vector<double>& den) {
+        if ((int)den.size() != N + 1 || den[0] == 0.0) {
+            throw invalid_argument("El denominador debe ser de orden N con coeficiente principal no nulo");
+        }
+        if (num.empty() || (int)num.size() > N + 1) {
+            throw invalid_argument("La funcion de transferencia debe ser propia");
+        }
+        
+        // Normalizar a denominador monico y completar el numerador a N+1 coeficientes
+        double a[N + 1], b[N + 1];
+        int offset = N + 1 - (int)num.size();
+        for (int k = 0; k <= N; k++) {
+            a[k] = den[k] / den[0];
+            b[k] = (k < offset) ? 0.0 : num[k - offset] / den[0];
+        }
+        
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                A[i][j] = (j == i + 1) ? 1.0 : 0.0;
+            }
+        }
+        for (int i = 0; i < N; i++) {
+            A[N - 1][i] = -a[N - i];
+            B[i] = (i == N - 1) ? 1.0 : 0.0;
+            C[i] = Real(b[N - i] - a[N - i] * b[0]);
+        }
+        D = Real(b[0]);
+        integrator = nullptr;
+        u_hold = 0.0;
+        
+        discretize();
+        reset();
+    }
+    
+    // Modelo continuo para los integradores: x_punto = Ax + B u_hold
+    int dimension() const { return N; }
+    
+    void derivative(double t, const double* xs, double* dxdt) const {
+        (void)t;
+        for (int i = 0; i < N; i++) {
+            double sum = B[i] * u_hold;
+            for (int j = 0; j < N; j++) {
+                sum += A[i][j] * xs[j];
+            }
+            dxdt[i] = sum;
+        }
+    }
+    
+    bool jacobian(double t, const double* xs, double* J) const {
+        (void)t; (void)xs;
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                J[i * N + j] = A[i][j];
+            }
+        }
+        return true;
+    }
+    
+    void setIntegrator(Integrator* integ) { integrator = integ; }
+    
+    // Avanza una muestra con entrada u constante durante tau_s
+    Real update(Real u) {
+        if (integrator != nullptr) {
+            double xs[N];
+            for (int i = 0; i < N; i++) xs[i] = x[i];
+            u_hold = u;
+            integrator->advance(*this, 0.0, tau_s, xs);
+            
+            Real y = D * u;
+            for (int i = 0; i < N; i++) {
+                x[i] = Real(xs[i]);
+                y += C[i] * x[i];
+            }
+            u_prev = u;
+            return y;
+        }
+        
+        Real x_new[N];
+        for (int i = 0; i < N; i++) {
+            Real sum = Bd[i] * u;
+            for (int j = 0; j < N; j++) {
+                sum += Ad[i][j] * x[j];
+            }
+            x_new[i] = sum;
+        }
+        
+        // Salida: y = Cx + Du
+        Real y = D * u;
+        for (int i = 0; i < N; i++) {
+            x[i] = x_new[i];
+            y += C[i] * x[i];
+        }
+        
+        u_prev = u;
+        return y;
+    }
+    
+    int order() const { return N; }
+    Real getState(int i) const { return x[i]; }
+    
+    void saveState(Real* xs, Real& u) const {
+        for (int i = 0; i < N; i++) xs[i] = x[i];
+        u = u_prev;
+    }
+    
+    void loadState(const Real* xs, Real u) {
+        for (int i = 0; i < N; i++) x[i] = xs[i];
+        u_prev = u;
+    }
+    
+    void reset() {
+        for (int i = 0; i < N; i++) x[i] = Real(0);
+        u_prev = Real(0);
+    }
+};
+
+// Clase para la Planta G(s) = (7s^2 - 28s + 21)/(s^3 + 9.8s^2 + 30.65s + 30.1)
+template <class Real>
+class BasicPlant : public LTIPlant<3, Real> {
+public:
+    BasicPlant() : LTIPlant<3, Real>(vector<double>{7.0, -28.0, 21.0},         // 7s^2 - 28s + 21
+                                     vector<double>{1.0, 9.8, 30.65, 30.1}) {}  // s^3 + 9.8s^2 + 30.65s + 30.1
+};
+
+typedef BasicPlant<double> Plant;
+
+// Archivo de solo lectura proyectado en memoria. Las paginas se cargan bajo demanda,
+// por lo que se pueden recorrer trazas mucho mas grandes que la RAM disponible.
+class MappedFile {
+private:
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE map_handle;
+#endif
+    
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+    
+public:
+    MappedFile() : data_(nullptr), size_(0) {
+#ifdef _WIN32
+        file_handle = INVALID_HANDLE_VALUE;
+        map_handle = NULL;
+#endif
+    }
+    
+    ~MappedFile() { close(); }
+    
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file_handle == INVALID_HANDLE_VALUE) return false;
+        
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_handle, &file_size)) { close(); return false; }
+        size_ = (size_t)file_size.QuadPart;
+        if (size_ == 0) return true;
+        
+        map_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map_handle == NULL) { close(); return false; }
+        data_ = (const char*)MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+        if (data_ == nullptr) { close(); return false; }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        
+        struct stat st;
+        if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+        size_ = (size_t)st.st_size;
+        if (size_ == 0) { ::close(fd); return true; }
+        
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) { size_ = 0; return false; }
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = (const char*)p;
+#endif
+        return true;
+    }
+    
+    void close() {
+#ifdef _WIN32
+        if (data_ != nullptr) UnmapViewOfFile(data_);
+        if (map_handle != NULL) CloseHandle(map_handle);
+        if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+        map_handle = NULL;
+        file_handle = INVALID_HANDLE_VALUE;
+#else
+        if (data_ != nullptr) munmap((void*)data_, size_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+    
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+};
+
+// Fuentes de senal de referencia en flujo. Cada llamada a next() entrega f(t) de la
+// siguiente muestra (t = k * tau_s). runHILLoop se instancia por tipo de fuente, asi
+// que el lazo no decide el tipo de senal en cada muestra.
+
+// Estado serializable de una fuente (cada fuente usa solo los campos que necesita)
+struct SourceState {
+    long long k;
+    long long i0, i1;
+    double d[5];
+    
+    SourceState() : k(0), i0(0), i1(0) {
+        for (int i = 0; i < 5; i++) d[i] = 0.0;
+    }
+};
+
+// Muestra a partir de la cual se activa una senal que inicia en t_start
+long startSample(double t_start) {
+    return (long)ceil(t_start / tau_s - 1e-9);
+}
+
+// Escalon de amplitud A que comienza en t_start
+class StepSource {
+private:
+    long k, k_start;
+    double amplitude;
+    
+public:
+    StepSource(double t_start = 1.0, double amplitude_ = 1.0)
+        : k(0), k_start(startSample(t_start)), amplitude(amplitude_) {}
+    
+    double next() {
+        return (k++ >= k_start) ? amplitude : 0.0;
+    }
+    
+    void save(SourceState& st) const { st.k = k; }
+    void restore(const SourceState& st) { k = (long)st.k; }
+};
+
+// Rampa de pendiente dada que comienza en t_start
+class RampSource {
+private:
+    long k, k_start;
+    double increment;  // Pendiente * tau_s
+    
+public:
+    RampSource(double t_start = 1.0, double slope = 0.5)
+        : k(0), k_start(startSample(t_start)), increment(slope * tau_s) {}
+    
+    double next() {
+        long active = k++ - k_start;
+        return (active >= 0) ? active * increment : 0.0;
+    }
+    
+    void save(SourceState& st) const { st.k = k; }
+    void restore(const SourceState& st) { k = (long)st.k; }
+};
+
+// Senoidal A*sin(2*pi*f*t) por rotacion recursiva del fasor (cos, sin): cada muestra
+// cuesta una multiplicacion compleja en lugar de una llamada a sin(). Un paso de Newton
+// por muestra (g = 1.5 - 0.5|p|^2) mantiene el modulo en 1 sin deriva de amplitud.
+class SineSource {
+private:
+    long k, k_start;
+    double amplitude;
+    double c, s;    // Fasor actual
+    double cr, sr;  // Rotacion por muestra
+    
+public:
+    SineSource(double frequency = 0.5, double t_start = 0.5, double amplitude_ = 1.0)
+        : k(0), k_start(startSample(t_start)), amplitude(amplitude_) {
+        double w = 2.0 * M_PI * frequency;
+        c = cos(w * k_start * tau_s);
+        s = sin(w * k_start * tau_s);
+        cr = cos(w * tau_s);
+        sr = sin(w * tau_s);
+    }
+    
+    double next() {
+        if (k++ < k_start) return 0.0;
+        
+        double out = amplitude * s;
+        double c_new = c * cr - s * sr;
+        double s_new = s * cr + c * sr;
+        double g = 1.5 - 0.5 * (c_new * c_new + s_new * s_new);
+        c = g * c_new;
+        s = g * s_new;
+        return out;
+    }
+    
+    void save(SourceState& st) const {
+        st.k = k;
+        st.d[0] = c;
+        st.d[1] = s;
+    }
+    
+    void restore(const SourceState& st) {
+        k = (long)st.k;
+        c = st.d[0];
+        s = st.d[1];
+    }
+};
+
+// Chirp lineal de f0 a f1 durante 'duration' segundos a partir de t_start; despues
+// continua a f1. El incremento de fase crece linealmente, asi que la rotacion por
+// muestra se obtiene a su vez rotando por un angulo constante 2*pi*beta*tau_s^2.
+class ChirpSource {
+private:
+    long k, k_start, k_end;
+    double amplitude;
+    double c, s;    // Fasor de la senal
+    double cr, sr;  // Rotacion de la muestra actual
+    double ca, sa;  // Rotacion de la rotacion (barrido)
+    double cr_end, sr_end;  // Rotacion a f1, al terminar el barrido
+    
+public:
+    ChirpSource(double f0 = 0.1, double f1 = 5.0, double duration = 20.0,
+                double t_start = 1.0, double amplitude_ = 1.0)
+        : k(0), k_start(startSample(t_start)), amplitude(amplitude_), c(1.0), s(0.0) {
+        k_end = k_start + (long)(duration / tau_s);
+        double beta = (f1 - f0) / duration;
+        // Incremento de fase entre las muestras 0 y 1 del barrido
+        double dphi0 = 2.0 * M_PI * (f0 * tau_s + 0.5 * beta * tau_s * tau_s);
+        double dphi_rate = 2.0 * M_PI * beta * tau_s * tau_s;
+        cr = cos(dphi0);
+        sr = sin(dphi0);
+        ca = cos(dphi_rate);
+        sa = sin(dphi_rate);
+        cr_end = cos(2.0 * M_PI * f1 * tau_s);
+        sr_end = sin(2.0 * M_PI * f1 * tau_s);
+    }
+    
+    double next() {
+        long kk = k++;
+        if (kk < k_start) return 0.0;
+        
+        double out = amplitude * s;
+        double c_new = c * cr - s * sr;
+        double s_new = s * cr + c * sr;
+        double g = 1.5 - 0.5 * (c_new * c_new + s_new * s_new);
+        c = g * c_new;
+        s = g * s_new;
+        
+        if (kk + 1 < k_end) {
+            double cr_new = cr * ca - sr * sa;
+            double sr_new = sr * ca + cr * sa;
+            g = 1.5 - 0.5 * (cr_new * cr_new + sr_new * sr_new);
+            cr = g * cr_new;
+            sr = g * sr_new;
+        } else {
+            cr = cr_end;
+            sr = sr_end;
+        }
+        return out;
+    }
+    
+    void save(SourceState& st) const {
+        st.k = k;
+        st.d[0] = c; st.d[1] = s;
+        st.d[2] = cr; st.d[3] = sr;
+    }
+    
+    void restore(const SourceState& st) {
+        k = (long)st.k;
+        c = st.d[0]; s = st.d[1];
+        cr = st.d[2]; sr = st.d[3];
+    }
+};
+
+// Secuencia binaria pseudoaleatoria PRBS-15 (x^15 + x^14 + 1, periodo 32767 bits),
+// con niveles +-A y cada bit mantenido durante bit_time segundos
+class PRBSSource {
+private:
+    long k, k_start;
+    double amplitude;
+    unsigned lfsr;
+    int hold_samples;
+    int hold_count;
+    double level;
+    
+public:
+    PRBSSource(double bit_time = 0.1, double t_start = 1.0, double amplitude_ = 1.0,
+               unsigned seed = 0x7FFF)
+        : k(0), k_start(startSample(t_start)), amplitude(amplitude_),
+          lfsr((seed & 0x7FFF) ? (seed & 0x7FFF) : 1u),
+          hold_samples(max(1, (int)(bit_time / tau_s + 0.5))), hold_count(0), level(0.0) {}
+    
+    double next() {
+        if (k++ < k_start) return 0.0;
+        
+        if (hold_count == 0) {
+            unsigned bit = ((lfsr >> 14) ^ (lfsr >> 13)) & 1u;
+            lfsr = ((lfsr << 1) | bit) & 0x7FFFu;
+            level = bit ? amplitude : -amplitude;
+            hold_count = hold_samples;
+        }
+        hold_count--;
+        return level;
+    }
+    
+    void save(SourceState& st) const {
+        st.k = k;
+        st.i0 = lfsr;
+        st.i1 = hold_count;
+        st.d[0] = level;
+    }
+    
+    void restore(const SourceState& st) {
+        k = (long)st.k;
+        lfsr = (unsigned)st.i0;
+        hold_count = (int)st.i1;
+        level = st.d[0];
+    }
+};
+
+// Reproduce una traza registrada (texto, un valor por linea; en CSV se toma la
+// columna indicada). El archivo se proyecta en memoria y se recorre en flujo, por lo
+// que no se carga completo. Las lineas de encabezado no numericas se ignoran y al
+// terminar la traza se mantiene el ultimo valor.
+class TraceReplaySource {
+private:
+    MappedFile file;
+    const char* pos;
+    const char* end;
+    int column;
+    double last;
+    long samples_read;
+    
+    static bool isNumberStart(char ch) {
+        return (ch >= '0' && ch <= '9') || ch == '-' || ch == '+' || ch == '.';
+    }
+    
+    static bool isSeparator(char ch) {
+        return ch == ',' || ch == ';' || ch == ' ' || ch == '\t';
+    }
+    
+    void skipLine() {
+        while (pos < end && *pos != '\n') pos++;
+        if (pos < end) pos++;
+    }
+    
+    void skipField() {
+        while (pos < end && !isSeparator(*pos) && *pos != '\n' && *pos != '\r') pos++;
+        while (pos < end && isSeparator(*pos)) pos++;
+    }
+    
+public:
+    TraceReplaySource(const string& path, int column_ = 0)
+        : pos(nullptr), end(nullptr), column(column_), last(0.0), samples_read(0) {
+        if (file.open(path)) {
+            pos = file.data();
+            end = pos + file.size();
+        }
+    }
+    
+    bool isOpen() const { return file.data() != nullptr; }
+    long samplesRead() const { return samples_read; }
+    
+    void save(SourceState& st) const {
+        st.i0 = isOpen() ? (long long)(pos - file.data()) : 0;
+        st.i1 = samples_read;
+        st.d[0] = last;
+    }
+    
+    void restore(const SourceState& st) {
+        if (isOpen()) pos = file.data() + min((size_t)st.i0, file.size());
+        samples_read = (long)st.i1;
+        last = st.d[0];
+    }
+    
+    double next() {
+        while (pos < end) {
+            const char* line = pos;
+            while (pos < end && (*pos == ' ' || *pos == '\t')) pos++;
+            if (pos >= end || !isNumberStart(*pos)) {
+                // Linea vacia, encabezado o comentario
+                pos = line;
+                skipLine();
+                continue;
+            }
+            
+            for (int c = 0; c < column && pos < end && *pos != '\n'; c++) skipField();
+            
+            // strtod necesita una cadena terminada en '\0': se copia solo el token
+            char buf[64];
+            int len = 0;
+            while (pos + len < end && len < 63 && !isSeparator(pos[len]) &&
+                   pos[len] != '\n' && pos[len] != '\r') {
+                buf[len] = pos[len];
+                len++;
+            }
+            buf[len] = '\0';
+            
+            char* parsed_end;
+            double value = strtod(buf, &parsed_end);
+            skipLine();
+            if (parsed_end != buf) {
+                last = value;
+                samples_read++;
+                return value;
+            }
+        }
+        return last;
+    }
+};
+
+// Registro multi-tasa de la traza. Con decimacion N > 1 cada fila resume una ventana de
+// N muestras: media de todas las senales y envolvente min/max de z1..z3, de modo que
+// el chattering del derivador sigue visible aunque se escriba una fila de cada N. Si
+// |z0 - f| o |z1| superan su umbral, el registro pasa a tasa completa (una fila por
+// muestra) durante holdSamples muestras desde el ultimo disparo.
+struct TraceLogConfig {
+    int decimation;          // Muestras por ventana (1 = tasa completa, formato de 8 columnas)
+    double errorThreshold;   // Disparo por error de seguimiento |z0 - f| (0 = deshabilitado)
+    double slopeThreshold;   // Disparo por derivada estimada |z1| (0 = deshabilitado)
+    long long holdSamples;   // Muestras a tasa completa despues de cada disparo
+    
+    TraceLogConfig() : decimation(1), errorThreshold(0.0), slopeThreshold(0.0), holdSamples(125) {}
+};
+
+// Estado serializable del registro: la ventana abierta viaja en el checkpoint. La fila
+// de cola que cierra cada corrida queda despues de la posicion guardada, de modo que al
+// continuar la traza se descarta y se escriben las mismas filas que sin interrupciones.
+struct TraceLogState {
+    TraceLogConfig config;
+    long long holdLeft;      // Muestras restantes a tasa completa
+    long long rows;          // Filas de datos escritas
+    int count;               // Muestras acumuladas en la ventana actual
+    double sum[8];           // t, f, u, y, z0, z1, z2, z3
+    double lo[3], hi[3];     // Envolventes de z1..z3
+    
+    TraceLogState() : holdLeft(0), rows(0), count(0) {
+        for (int i = 0; i < 8; i++) sum[i] = 0.0;
+        for (int i = 0; i < 3; i++) lo[i] = hi[i] = 0.0;
+    }
+};
+
+class TraceLogger {
+private:
+    ostream& out;
+    TraceLogState st;
+    
+    void writeRow(const double* v, const double* lo, const double* hi, int samples) {
+        out << v[0];
+        for (int i = 1; i < 8; i++) out << ',' << v[i];
+        if (st.config.decimation > 1) {
+            for (int i = 0; i < 3; i++) out << ',' << lo[i] << ',' << hi[i];
+            out << ',' << samples;
+        }
+        out << '\n';
+        st.rows++;
+    }
+    
+    bool triggered(const double* v) const {
+        return (st.config.errorThreshold > 0.0 && fabs(v[4] - v[1]) > st.config.errorThreshold) ||
+               (st.config.slopeThreshold > 0.0 && fabs(v[5]) > st.config.slopeThreshold);
+    }
+    
+public:
+    TraceLogger(ostream& out_, const TraceLogState& state) : out(out_), st(state) {
+        out << fixed << setprecision(8);
+    }
+    
+    // Encabezado CSV segun el formato (8 columnas o resumen por ventana)
+    void writeHeader() {
+        out << "Tiempo,Referencia_f(t),Entrada_Planta_u(t),Salida_Planta_y(t),"
+            << "z0_Seguimiento,z1_Derivada1,z2_Derivada2,z3_Derivada3";
+        if (st.config.decimation > 1) {
+            out << ",z1_Min,z1_Max,z2_Min,z2_Max,z3_Min,z3_Max,Muestras";
+        }
+        out << '\n';
+    }
+    
+    // Registra una muestra: v = {t, f, u, y, z0, z1, z2, z3}
+    void record(const double* v) {
+        if (st.config.decimation <= 1) {
+            writeRow(v, nullptr, nullptr, 1);
+            return;
+        }
+        
+        if (triggered(v)) st.holdLeft = st.config.holdSamples;
+        if (st.holdLeft > 0) {
+            st.holdLeft--;
+            flush();
+            writeRow(v, v + 5, v + 5, 1);
+            return;
+        }
+        
+        if (st.count == 0) {
+            for (int i = 0; i < 3; i++) st.lo[i] = st.hi[i] = v[5 + i];
+        }
+        for (int i = 0; i < 8; i++) st.sum[i] += v[i];
+        for (int i = 0; i < 3; i++) {
+            st.lo[i] = min(st.lo[i], v[5 + i]);
+            st.hi[i] = max(st.hi[i], v[5 + i]);
+        }
+        if (++st.count == st.config.decimation) flush();
+    }
+    
+    // Escribe la ventana pendiente (incompleta) como una fila; el tiempo es el centro
+    // de la ventana
+    void flush() {
+        if (st.count == 0) return;
+        double mean[8];
+        for (int i = 0; i < 8; i++) mean[i] = st.sum[i] / st.count;
+        writeRow(mean, st.lo, st.hi, st.count);
+        st.count = 0;
+        for (int i = 0; i < 8; i++) st.sum[i] = 0.0;
+    }
+    
+    const TraceLogState& state() const { return st; }
+    long long rows() const { return st.rows; }
+};
+
+// Muestras entre checkpoints automaticos (10 s de simulacion)
+const long CHECKPOINT_INTERVAL = 2500;
+
+// Instantanea compacta del estado de una simulacion HIL. Permite continuar una corrida
+// larga o bifurcar varias ramas desde un estado comun sin re-simular el prefijo.
+struct HILCheckpoint {
+    int signalType;
+    int integratorType;
+    long long sample;      // Indice de la siguiente muestra a simular
+    long long tracePos;    // Bytes validos en el archivo de traza
+    double z[4];           // Estados del derivador
+    double x[MAX_PLANT_ORDER];
+    int plantOrder;
+    double u_prev;
+    double stepHint;       // Paso adaptativo del integrador
+    SourceState source;
+    TraceLogState logger;  // Configuracion y ventana pendiente del registro
+    string traceFile;      // Archivo CSV de salida
+    string tracePath;      // Traza de entrada (fuente de reproduccion)
     
-    void reset() {
-        z0 = z1 = z2 = z3 = 0;
+    HILCheckpoint() : signalType(1), integratorType(1), sample(0), tracePos(0),
+                      plantOrder(0), u_prev(0.0), stepHint(0.0) {
+        for (int i = 0; i < 4; i++) z[i] = 0.0;
+        for (int i = 0; i < MAX_PLANT_ORDER; i++) x[i] = 0.0;
     }
 };
 
-// Clase para la Planta G(s) = (7s^2 - 28s + 21)/(s^3 + 9.8s^2 + 30.65s + 30.1)
-class Plant {
-private:
-    // Coeficientes continuos
-    vector<double> num_cont = {7.0, -28.0, 21.0};      // 7s^2 - 28s + 21
-    vector<double> den_cont = {1.0, 9.8, 30.65, 30.1}; // s^3 + 9.8s^2 + 30.65s + 30.1
+const char HIL_CHECKPOINT_MAGIC[8] = {'H', 'I', 'L', 'C', 'K', 'P', 'T', '\0'};
+const unsigned HIL_CHECKPOINT_VERSION = 2;
+
+template <class T>
+void writePod(ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+bool readPod(istream& in, T& value) {
+    return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+void writeString(ostream& out, const string& str) {
+    writePod(out, (unsigned)str.size());
+    out.write(str.data(), str.size());
+}
+
+bool readString(istream& in, string& str) {
+    unsigned len;
+    if (!readPod(in, len) || len > 4096) return false;
+    str.resize(len);
+    return len == 0 || (bool)in.read(&str[0], len);
+}
+
+// Formato binario nativo: magia, version y campos de longitud fija; solo se
+// escriben los plantOrder estados de la planta
+bool saveCheckpoint(const string& path, const HILCheckpoint& c) {
+    ofstream out(path.c_str(), ios::binary | ios::trunc);
+    if (!out.is_open()) return false;
     
-    // Estados para ecuaciones de estado (forma controlable)
-    vector<double> x;
-    double u_prev;
+    out.write(HIL_CHECKPOINT_MAGIC, sizeof(HIL_CHECKPOINT_MAGIC));
+    writePod(out, HIL_CHECKPOINT_VERSION);
+    writePod(out, c.signalType);
+    writePod(out, c.integratorType);
+    writePod(out, c.sample);
+    writePod(out, c.tracePos);
+    for (int i = 0; i < 4; i++) writePod(out, c.z[i]);
+    writePod(out, c.plantOrder);
+    for (int i = 0; i < c.plantOrder; i++) writePod(out, c.x[i]);
+    writePod(out, c.u_prev);
+    writePod(out, c.stepHint);
+    writePod(out, c.source);
+    writePod(out, c.logger);
+    writeString(out, c.traceFile);
+    writeString(out, c.tracePath);
+    return (bool)out;
+}
+
+bool loadCheckpoint(const string& path, HILCheckpoint& c) {
+    ifstream in(path.c_str(), ios::binary);
+    if (!in.is_open()) return false;
     
-public:
-    Plant() {
-        x.resize(3, 0.0);
-        u_prev = 0.0;
-    }
-    
-    // Metodo de integracion Runge-Kutta 4 para estabilidad
-    double update(double u) {
-        // Ecuaciones de estado de la planta en forma continua
-        // x_punto = Ax + Bu, y = Cx + Du
-        
-        // Coeficientes de la ecuacion diferencial
-        double a0 = -den_cont[3] / den_cont[0];
-        double a1 = -den_cont[2] / den_cont[0];
-        double a2 = -den_cont[1] / den_cont[0];
-        
-        double b0 = num_cont[2] / den_cont[0];
-        double b1 = (num_cont[1] - b0 * den_cont[2]) / den_cont[0];
-        double b2 = (num_cont[0] - b0 * den_cont[1] - b1 * den_cont[2]) / den_cont[0];
-        
-        // RK4 para integracion numerica
-        vector<double> k1(3), k2(3), k3(3), k4(3), x_temp(3);
-        
-        // k1
-        k1[0] = x[1];
-        k1[1] = x[2];
-        k1[2] = a0 * x[0] + a1 * x[1] + a2 * x[2] + u;
-        
-        // k2
-        for (int i = 0; i < 3; i++) x_temp[i] = x[i] + 0.5 * tau_s * k1[i];
-        k2[0] = x_temp[1];
-        k2[1] = x_temp[2];
-        k2[2] = a0 * x_temp[0] + a1 * x_temp[1] + a2 * x_temp[2] + u;
-        
-        // k3
-        for (int i = 0; i < 3; i++) x_temp[i] = x[i] + 0.5 * tau_s * k2[i];
-        k3[0] = x_temp[1];
-        k3[1] = x_temp[2];
-        k3[2] = a0 * x_temp[0] + a1 * x_temp[1] + a2 * x_temp[2] + u;
-        
-        // k4
-        for (int i = 0; i < 3; i++) x_temp[i] = x[i] + tau_s * k3[i];
-        k4[0] = x_temp[1];
-        k4[1] = x_temp[2];
-        k4[2] = a0 * x_temp[0] + a1 * x_temp[1] + a2 * x_temp[2] + u;
-        
-        // Actualizar estado
-        for (int i = 0; i < 3; i++) {
-            x[i] = x[i] + (tau_s / 6.0) * (k1[i] + 2*k2[i] + 2*k3[i] + k4[i]);
-        }
-        
-        // Salida: y = Cx + Du
-        double y = b0 * x[0] + b1 * x[1] + b2 * x[2];
-        
-        u_prev = u;
-        return y;
+    char magic[sizeof(HIL_CHECKPOINT_MAGIC)];
+    unsigned version;
+    if (!in.read(magic, sizeof(magic)) ||
+        !equal(magic, magic + sizeof(magic), HIL_CHECKPOINT_MAGIC) ||
+        !readPod(in, version) || version != HIL_CHECKPOINT_VERSION) {
+        return false;
     }
     
-    void reset() {
-        fill(x.begin(), x.end(), 0.0);
-        u_prev = 0.0;
+    bool ok = readPod(in, c.signalType) && readPod(in, c.integratorType) &&
+              readPod(in, c.sample) && readPod(in, c.tracePos);
+    for (int i = 0; ok && i < 4; i++) ok = readPod(in, c.z[i]);
+    ok = ok && readPod(in, c.plantOrder) && c.plantOrder >= 0 && c.plantOrder <= MAX_PLANT_ORDER;
+    for (int i = 0; ok && i < c.plantOrder; i++) ok = readPod(in, c.x[i]);
+    return ok && readPod(in, c.u_prev) && readPod(in, c.stepHint) && readPod(in, c.source) &&
+           readPod(in, c.logger) && c.logger.config.decimation >= 1 &&
+           readString(in, c.traceFile) && readString(in, c.tracePath);
+}
+
+// Recorta un archivo a 'size' bytes (descarta filas escritas despues del checkpoint)
+bool truncateFile(const string& path, long long size) {
+#ifdef _WIN32
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER offset;
+    offset.QuadPart = size;
+    bool ok = SetFilePointerEx(h, offset, NULL, FILE_BEGIN) && SetEndOfFile(h);
+    CloseHandle(h);
+    return ok;
+#else
+    return truncate(path.c_str(), (off_t)size) == 0;
+#endif
+}
+
+// Tiempo de la muestra en segundos, sin decimales si es entero (nombres de archivo)
+string formatSeconds(long long sample) {
+    ostringstream text;
+    text << fixed << setprecision(sample % 250 == 0 ? 0 : 3) << sample * tau_s;
+    return text.str();
+}
+
+// Ultimo checkpoint de una traza (se reemplaza en cada guardado)
+string latestCheckpointPath(const string& traceFile) {
+    return traceFile + ".ckpt";
+}
+
+// Instantanea permanente de una traza en la muestra dada: <traza>.t<seg>.ckpt
+string snapshotCheckpointPath(const string& traceFile, long long sample) {
+    return traceFile + ".t" + formatSeconds(sample) + ".ckpt";
+}
+
+// Primer nombre libre para una rama de traceFile desde la muestra dada:
+// <base>_rama_t<seg>_<n>.txt, de modo que varias ramas del mismo estado no se pisan
+string branchFileName(const string& traceFile, long long sample) {
+    string base = traceFile;
+    size_t dot = base.rfind('.');
+    if (dot != string::npos) base = base.substr(0, dot);
+    
+    for (int n = 1; ; n++) {
+        ostringstream name;
+        name << base << "_rama_t" << formatSeconds(sample) << "_" << n << ".txt";
+        ifstream probe(name.str().c_str());
+        if (!probe.is_open()) return name.str();
     }
-};
+}
+
+template <class Source>
+void captureCheckpoint(HILCheckpoint& c, long long sample, const Source& source,
+                       const HighOrderDerivator& derivator, const Plant& plant,
+                       const Integrator* integrator, const TraceLogger& logger, ofstream& outFile) {
+    outFile.flush();
+    c.sample = sample;
+    c.tracePos = (long long)outFile.tellp();
+    derivator.saveState(c.z);
+    c.plantOrder = plant.order();
+    plant.saveState(c.x, c.u_prev);
+    c.stepHint = integrator ? integrator->stepSizeHint() : 0.0;
+    source.save(c.source);
+    c.logger = logger.state();
+}
 
-// Generadores de senales de referencia
-double stepSignal(double t) {
-    // Escalon que comienza en t=1s con amplitud 1
-    return (t >= 1.0) ? 1.0 : 0.0;
+// Restaura el estado del checkpoint. Con sameSource == false la fuente es otra (rama
+// con otra senal): se la lleva hasta la muestra del checkpoint en lugar de restaurarla.
+template <class Source>
+void restoreCheckpoint(const HILCheckpoint& c, Source& source, HighOrderDerivator& derivator,
+                       Plant& plant, Integrator* integrator, bool sameSource) {
+    derivator.loadState(c.z);
+    plant.loadState(c.x, c.u_prev);
+    if (integrator) integrator->setStepSizeHint(c.stepHint);
+    if (sameSource) {
+        source.restore(c.source);
+    } else {
+        for (long long k = 0; k < c.sample; k++) source.next();
+    }
 }
 
-double rampSignal(double t) {
-    // Rampa que comienza en t=1s con pendiente 0.5
-    return (t >= 1.0) ? (t - 1.0) * 0.5 : 0.0;
+// Lazo HIL sobre las muestras [kBegin, kEnd), instanciado para cada tipo de fuente
+template <class Source>
+void runHILLoop(Source& source, HighOrderDerivator& derivator, Plant& plant,
+                TraceLogger& logger, long kBegin, long kEnd, long progressOrigin, long progressStep) {
+    for (long k = kBegin; k < kEnd; k++) {
+        double t = k * tau_s;
+        
+        // 1. Generar senal de referencia f(t)
+        double f_ref = source.next();
+        
+        // 2. Actualizar derivador con la senal de referencia
+        //    El derivador calcula z0 (seguimiento), z1, z2, z3 (derivadas)
+        derivator.update(f_ref);
+        
+        // 3. Usar z0 como entrada a la planta (seguimiento de referencia)
+        double plant_input = derivator.getZ0();
+        
+        // 4. Actualizar planta con la entrada
+        double plant_output = plant.update(plant_input);
+        
+        // 5. Registrar todas las senales (a tasa completa o por ventanas)
+        double row[8] = {t, f_ref, plant_input, plant_output, derivator.getZ0(),
+                         derivator.getZ1(), derivator.getZ2(), derivator.getZ3()};
+        logger.record(row);
+        
+        // Mostrar barra de progreso
+        if ((k - progressOrigin) % progressStep == 0) {
+            cout << "=" << flush;
+        }
+    }
 }
 
-double sinusoidalSignal(double t) {
-    // Senoidal: sin(2*pi*f*t) con f=0.5 Hz, comienza en t=0.5s
-    return (t >= 0.5) ? sin(2.0 * M_PI * 0.5 * t) : 0.0;
+// Simula totalSamples muestras desde el checkpoint c (o desde cero si c.sample == 0).
+// Cada CHECKPOINT_INTERVAL muestras y al final guarda el ultimo checkpoint de la traza
+// y una instantanea por tiempo, desde la que luego se pueden bifurcar ramas. Al final
+// la ventana abierta se guarda en el checkpoint y recien despues se escribe como fila
+// de cola (Muestras < decimacion), que truncateFile quita al continuar la traza.
+template <class Source>
+void runHILSegments(Source& source, HighOrderDerivator& derivator, Plant& plant,
+                    Integrator* integrator, TraceLogger& logger, ofstream& outFile,
+                    HILCheckpoint& c, long totalSamples, bool sameSource) {
+    if (c.sample > 0) restoreCheckpoint(c, source, derivator, plant, integrator, sameSource);
+    
+    long kBegin = (long)c.sample;
+    long kEnd = kBegin + totalSamples;
+    long progressStep = max(1L, totalSamples / 50);
+    
+    for (long k = kBegin; k < kEnd; k += CHECKPOINT_INTERVAL) {
+        long segmentEnd = min(kEnd, k + CHECKPOINT_INTERVAL);
+        runHILLoop(source, derivator, plant, logger, k, segmentEnd, kBegin, progressStep);
+        captureCheckpoint(c, segmentEnd, source, derivator, plant, integrator, logger, outFile);
+        string snapshot = snapshotCheckpointPath(c.traceFile, c.sample);
+        if (!saveCheckpoint(latestCheckpointPath(c.traceFile), c) || !saveCheckpoint(snapshot, c)) {
+            cerr << "\nError: No se pudo guardar el checkpoint " << snapshot << endl;
+        }
+    }
+    logger.flush();
 }
 
 // Funcion principal de simulacion HIL
-void runHILSimulation(int signalType, double simTime, const string& filename) {
+// signalType: 1 = escalon, 2 = rampa, 3 = senoidal, 4 = chirp, 5 = PRBS, 6 = traza (tracePath)
+// integratorType: 1 = RK4 discretizado, 2 = Dormand-Prince 5(4), 3 = TR-BDF2
+// resume: checkpoint desde el cual continuar (nullptr = simulacion nueva). Si filename
+// coincide con la traza del checkpoint se continua ese archivo; si no, se crea una rama,
+// que puede usar otra senal o integrador que el checkpoint.
+// logConfig: decimacion y disparos del registro (al continuar la misma traza se usa la
+// del checkpoint)
+void runHILSimulation(int signalType, double simTime, const string& filename,
+                      int integratorType = 1, const string& tracePath = "",
+                      const HILCheckpoint* resume = nullptr,
+                      const TraceLogConfig& logConfig = TraceLogConfig()) {
     Plant plant;
     HighOrderDerivator derivator;
     
-    ofstream outFile(filename);
+    DormandPrince54 dopri;
+    TRBDF2Integrator trbdf2;
+    Integrator* integrator = nullptr;
+    if (integratorType == 2) integrator = &dopri;
+    else if (integratorType == 3) integrator = &trbdf2;
+    plant.setIntegrator(integrator);
+    
+    HILCheckpoint checkpoint;
+    if (resume) checkpoint = *resume;
+    bool continueTrace = resume && resume->traceFile == filename;
+    bool sameSource = !resume || (resume->signalType == signalType && resume->tracePath == tracePath);
+    // El paso adaptativo guardado solo sirve para el mismo integrador
+    if (resume && resume->integratorType != integratorType) checkpoint.stepHint = 0.0;
+    checkpoint.signalType = signalType;
+    checkpoint.integratorType = integratorType;
+    checkpoint.tracePath = tracePath;
+    if (!continueTrace) {
+        checkpoint.logger = TraceLogState();
+        checkpoint.logger.config = logConfig;
+    }
+    
+    ofstream outFile;
+    if (continueTrace) {
+        // Descartar lo escrito despues del checkpoint y continuar al final del archivo
+        if (truncateFile(filename, resume->tracePos)) {
+            outFile.open(filename.c_str(), ios::in | ios::out);
+            outFile.seekp(0, ios::end);
+        }
+    } else {
+        outFile.open(filename.c_str());
+    }
     if (!outFile.is_open()) {
         cerr << "Error: No se pudo crear el archivo " << filename << endl;
         return;
     }
+    checkpoint.traceFile = filename;
     
-    // Encabezado del archivo con todas las senales requeridas
-    outFile << "Tiempo,Referencia_f(t),Entrada_Planta_u(t),Salida_Planta_y(t),"
-            << "z0_Seguimiento,z1_Derivada1,z2_Derivada2,z3_Derivada3" << endl;
+    TraceLogger logger(outFile, checkpoint.logger);
+    if (!continueTrace) {
+        // Encabezado del archivo con todas las senales requeridas
+        logger.writeHeader();
+    }
+    long long rowsBefore = logger.rows();
+    const TraceLogConfig& log = checkpoint.logger.config;
     
     cout << "\n+============================================================+" << endl;
     cout << "|       SIMULACION HIL - Hardware in the Loop              |" << endl;
@@ -189,7 +1512,8 @@ void runHILSimulation(int signalType, double simTime, const string& filename) {
     cout << "------------------------------------------------------------" << endl;
     cout << "- Planta: G(s) = (7s^2-28s+21)/(s^3+9.8s^2+30.65s+30.1)" << endl;
     cout << "- Frecuencia de muestreo: 250 Hz (Ts = 0.004 s)" << endl;
-    cout << "- Metodo de discretizacion: Runge-Kutta 4 orden" << endl;
+    cout << "- Metodo de discretizacion: "
+         << (integrator ? integrator->name() : "Runge-Kutta 4 orden (precalculado)") << endl;
     cout << "- Constante de Lipschitz: L = " << L << endl;
     cout << "- Parametros lambda: [" << lambda0 << ", " << lambda1 << ", " 
          << lambda2 << ", " << lambda3 << "]" << endl;
@@ -197,52 +1521,70 @@ void runHILSimulation(int signalType, double simTime, const string& filename) {
     
     if (signalType == 1) cout << "ESCALON UNITARIO (en t=1s)" << endl;
     else if (signalType == 2) cout << "RAMPA (pendiente=0.5, inicia en t=1s)" << endl;
-    else cout << "SENOIDAL (f=0.5Hz, inicia en t=0.5s)" << endl;
+    else if (signalType == 3) cout << "SENOIDAL (f=0.5Hz, inicia en t=0.5s)" << endl;
+    else if (signalType == 4) cout << "CHIRP (0.1 -> 5 Hz en 20 s, inicia en t=1s)" << endl;
+    else if (signalType == 5) cout << "PRBS-15 (+-1, bit de 0.1 s, inicia en t=1s)" << endl;
+    else cout << "TRAZA REGISTRADA (" << tracePath << ")" << endl;
     
     cout << "- Tiempo de simulacion: " << simTime << " segundos" << endl;
+    if (log.decimation > 1) {
+        cout << "- Registro: 1 fila cada " << log.decimation << " muestras (media y min/max)";
+        if (log.errorThreshold > 0.0 || log.slopeThreshold > 0.0) {
+            cout << ", tasa completa " << log.holdSamples * tau_s << " s tras |z0 - f| > "
+                 << log.errorThreshold << " o |z1| > " << log.slopeThreshold
+                 << " (0 = sin disparo)";
+        }
+        cout << endl;
+    } else {
+        cout << "- Registro: todas las muestras" << endl;
+    }
+    if (resume) {
+        cout << "- Reanudando desde t = " << resume->sample * tau_s << " s ("
+             << (continueTrace ? "misma traza" : "nueva rama") << ")" << endl;
+    }
     cout << "------------------------------------------------------------\n" << endl;
     
     int totalSamples = static_cast<int>(simTime / tau_s);
-    int progressStep = max(1, totalSamples / 50);
     
     auto startTime = chrono::high_resolution_clock::now();
     
     cout << "Ejecutando simulacion..." << endl;
     cout << "[";
     
-    for (int k = 0; k < totalSamples; k++) {
-        double t = k * tau_s;
-        
-        // 1. Generar senal de referencia f(t)
-        double f_ref;
-        if (signalType == 1) f_ref = stepSignal(t);
-        else if (signalType == 2) f_ref = rampSignal(t);
-        else f_ref = sinusoidalSignal(t);
-        
-        // 2. Actualizar derivador con la senal de referencia
-        //    El derivador calcula z0 (seguimiento), z1, z2, z3 (derivadas)
-        derivator.update(f_ref);
-        
-        // 3. Usar z0 como entrada a la planta (seguimiento de referencia)
-        double plant_input = derivator.getZ0();
-        
-        // 4. Actualizar planta con la entrada
-        double plant_output = plant.update(plant_input);
-        
-        // 5. Guardar todas las senales en el archivo
-        outFile << fixed << setprecision(8)
-                << t << ","
-                << f_ref << ","
-                << plant_input << ","
-                << plant_output << ","
-                << derivator.getZ0() << ","
-                << derivator.getZ1() << ","
-                << derivator.getZ2() << ","
-                << derivator.getZ3() << endl;
-        
-        // Mostrar barra de progreso
-        if (k % progressStep == 0) {
-            cout << "=" << flush;
+    switch (signalType) {
+        case 1: {
+            StepSource source;
+            runHILSegments(source, derivator, plant, integrator, logger, outFile, checkpoint, totalSamples, sameSource);
+            break;
+        }
+        case 2: {
+            RampSource source;
+            runHILSegments(source, derivator, plant, integrator, logger, outFile, checkpoint, totalSamples, sameSource);
+            break;
+        }
+        case 3: {
+            SineSource source;
+            runHILSegments(source, derivator, plant, integrator, logger, outFile, checkpoint, totalSamples, sameSource);
+            break;
+        }
+        case 4: {
+            ChirpSource source;
+            runHILSegments(source, derivator, plant, integrator, logger, outFile, checkpoint, totalSamples, sameSource);
+            break;
+        }
+        case 5: {
+            PRBSSource source;
+            runHILSegments(source, derivator, plant, integrator, logger, outFile, checkpoint, totalSamples, sameSource);
+            break;
+        }
+        default: {
+            TraceReplaySource source(tracePath);
+            if (!source.isOpen()) {
+                cerr << "\nError: No se pudo abrir la traza " << tracePath << endl;
+                return;
+            }
+            runHILSegments(source, derivator, plant, integrator, logger, outFile, checkpoint, totalSamples, sameSource);
+            break;
         }
     }
     
@@ -258,8 +1600,25 @@ void runHILSimulation(int signalType, double simTime, const string& filename) {
     cout << "+============================================================+" << endl;
     cout << "[OK] Muestras procesadas: " << totalSamples << endl;
     cout << "[OK] Tiempo de ejecucion: " << duration.count() << " ms" << endl;
+    if (integrator) {
+        cout << "[OK] Evaluaciones de f: " << integrator->functionEvaluations()
+             << " (" << fixed << setprecision(2)
+             << (double)integrator->functionEvaluations() / max(1, totalSamples) << " por muestra)" << endl;
+        cout << "[OK] Pasos aceptados/rechazados: " << integrator->acceptedSteps()
+             << "/" << integrator->rejectedSteps()
+             << ", jacobianos: " << integrator->jacobianEvaluations() << endl;
+    } else {
+        cout << "[OK] Evaluaciones de f: equivalente a 4 por muestra (RK4 precalculado)" << endl;
+    }
     cout << "[OK] Datos guardados en: " << filename << endl;
-    cout << "[OK] Formato: CSV con 8 columnas" << endl;
+    cout << "[OK] Checkpoint (t = " << formatSeconds(checkpoint.sample) << " s): "
+         << latestCheckpointPath(filename) << endl;
+    cout << "[OK] Instantaneas cada " << formatSeconds(CHECKPOINT_INTERVAL) << " s para ramas: " << filename
+         << ".t<seg>.ckpt" << endl;
+    long long rows = logger.rows() - rowsBefore;
+    cout << "[OK] Filas escritas: " << rows << " (" << fixed << setprecision(1)
+         << (double)totalSamples / max(1LL, rows) << " muestras por fila)" << endl;
+    cout << "[OK] Formato: CSV con " << (log.decimation > 1 ? 15 : 8) << " columnas" << endl;
     cout << "\nColumnas del archivo:" << endl;
     cout << "  1. Tiempo (s)" << endl;
     cout << "  2. Referencia f(t)" << endl;
@@ -269,16 +1628,317 @@ void runHILSimulation(int signalType, double simTime, const string& filename) {
     cout << "  6. z1 - Primera derivada" << endl;
     cout << "  7. z2 - Segunda derivada" << endl;
     cout << "  8. z3 - Tercera derivada" << endl;
+    if (log.decimation > 1) {
+        cout << "  (1-8 son medias de la ventana; el tiempo es su centro)" << endl;
+        cout << "  9-14. Envolventes min/max de z1, z2 y z3 en la ventana" << endl;
+        cout << "  15. Muestras en la ventana (1 = tasa completa)" << endl;
+    }
     cout << "============================================================\n" << endl;
 }
 
-int main() {
-    cout << "\n+==============================================================+" << endl;
-    cout << "|     TRABAJO PRACTICO No. 4 - Punto 2 (50%)                  |" << endl;
-    cout << "|     Sistema HIL: Planta SISO + Derivador Orden Superior    |" << endl;
-    cout << "|     Programacion Avanzada - Ing. Mecatronica               |" << endl;
-    cout << "+==============================================================+\n" << endl;
+#ifdef HIL_BENCHMARK
+// Benchmark del kernel HIL (compilar con -DHIL_BENCHMARK). Mide ns por muestra de
+// HighOrderDerivator::update, Plant::update, de la salida densa de Dormand-Prince con
+// entrada continua y del lazo combinado, sin E/S de archivo ni barra de progreso. El
+// throughput (ns/muestra) se mide sobre el lote completo; la latencia (mediana, p99,
+// maximo) se mide muestra a muestra descontando el costo de leer el reloj.
+
+typedef chrono::steady_clock BenchClock;
+
+volatile double bench_sink = 0.0;  // Evita que el compilador elimine el trabajo medido
+
+struct BenchResult {
+    string name;
+    double mean_ns;
+    double median_ns;
+    double p99_ns;
+    double max_ns;
+};
+
+double elapsedNs(BenchClock::time_point a, BenchClock::time_point b) {
+    return (double)chrono::duration_cast<chrono::nanoseconds>(b - a).count();
+}
+
+// Mediana del costo de dos lecturas consecutivas del reloj
+double timerOverheadNs() {
+    vector<double> samples(10000);
+    for (size_t i = 0; i < samples.size(); i++) {
+        BenchClock::time_point a = BenchClock::now();
+        BenchClock::time_point b = BenchClock::now();
+        samples[i] = elapsedNs(a, b);
+    }
+    sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+template <class Step>
+BenchResult benchmarkStep(const string& name, Step step, int steps, double overhead) {
+    BenchResult r;
+    r.name = name;
+    
+    // Calentamiento
+    for (int k = 0; k < steps / 10; k++) step(k);
+    
+    BenchClock::time_point t0 = BenchClock::now();
+    for (int k = 0; k < steps; k++) step(k);
+    BenchClock::time_point t1 = BenchClock::now();
+    r.mean_ns = elapsedNs(t0, t1) / steps;
+    
+    vector<double> latency(steps);
+    for (int k = 0; k < steps; k++) {
+        BenchClock::time_point a = BenchClock::now();
+        step(k);
+        BenchClock::time_point b = BenchClock::now();
+        latency[k] = max(0.0, elapsedNs(a, b) - overhead);
+    }
+    sort(latency.begin(), latency.end());
+    r.median_ns = latency[steps / 2];
+    r.p99_ns = latency[min(steps - 1, (int)(0.99 * steps))];
+    r.max_ns = latency[steps - 1];
+    return r;
+}
+
+// Planta con entrada continua u(t) = sin(pi t) (senoidal de 0.5 Hz sin retencion de
+// orden cero). Como la entrada no salta en los instantes de muestreo, Dormand-Prince
+// puede dar pasos que abarcan varias muestras y obtener las intermedias por salida
+// densa, en lugar de cortar un paso en cada muestra como en Plant::update.
+class SineInputPlant : public Plant {
+public:
+    void derivative(double t, const double* xs, double* dxdt) const {
+        double u = sin(3.14159265358979323846 * t);
+        for (int i = 0; i < 3; i++) {
+            double sum = B[i] * u;
+            for (int j = 0; j < 3; j++) sum += A[i][j] * xs[j];
+            dxdt[i] = sum;
+        }
+    }
+};
+
+// Muestras por llamada a integrateDense en el benchmark (1 s de simulacion)
+const int DENSE_BLOCK = 250;
+
+int main(int argc, char* argv[]) {
+    int steps = 200000;
+    bool csv = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--csv") csv = true;
+        else steps = max(100, atoi(argv[i]));
+    }
+    
+    // Referencia precalculada para aislar el costo de cada kernel
+    vector<double> ref(steps);
+    SineSource sine(0.5, 0.0);
+    for (int k = 0; k < steps; k++) ref[k] = sine.next();
+    vector<float> ref_f(ref.begin(), ref.end());
+    
+    double overhead = timerOverheadNs();
+    vector<BenchResult> results;
+    
+    {
+        HighOrderDerivator d;
+        results.push_back(benchmarkStep("Derivador<double>::update", [&](int k) {
+            d.update(ref[k]);
+            bench_sink = d.getZ0();
+        }, steps, overhead));
+    }
+    {
+        BasicHighOrderDerivator<float> d;
+        results.push_back(benchmarkStep("Derivador<float>::update", [&](int k) {
+            d.update(ref_f[k]);
+            bench_sink = d.getZ0();
+        }, steps, overhead));
+    }
+    {
+        Plant p;
+        results.push_back(benchmarkStep("Planta<double> RK4 precalculado", [&](int k) {
+            bench_sink = p.update(ref[k]);
+        }, steps, overhead));
+    }
+    {
+        BasicPlant<float> p;
+        results.push_back(benchmarkStep("Planta<float> RK4 precalculado", [&](int k) {
+            bench_sink = p.update(ref_f[k]);
+        }, steps, overhead));
+    }
+    
+    RK4Integrator rk4;
+    DormandPrince54 dopri;
+    TRBDF2Integrator trbdf2;
+    Integrator* integrators[] = {&rk4, &dopri, &trbdf2};
+    for (int i = 0; i < 3; i++) {
+        Plant p;
+        p.setIntegrator(integrators[i]);
+        results.push_back(benchmarkStep(string("Planta ") + integrators[i]->name(), [&](int k) {
+            bench_sink = p.update(ref[k]);
+        }, steps, overhead));
+    }
+    
+    // Entrada continua con Dormand-Prince: un advance() por muestra contra salida densa
+    // por bloques de DENSE_BLOCK muestras (la latencia de este caso es la de un bloque)
+    SineInputPlant continuous;
+    double x_step[3] = {0.0, 0.0, 0.0};
+    results.push_back(benchmarkStep("Entrada continua DOPRI, paso por muestra", [&](int k) {
+        dopri.advance(continuous, k * tau_s, (k + 1) * tau_s, x_step);
+        bench_sink = x_step[0];
+    }, steps, overhead));
+    
+    double x_dense[3] = {0.0, 0.0, 0.0};
+    vector<double> sample_times(DENSE_BLOCK), dense_out(DENSE_BLOCK * 3);
+    results.push_back(benchmarkStep("Entrada continua DOPRI, salida densa", [&](int k) {
+        if (k % DENSE_BLOCK != 0) return;
+        for (int i = 0; i < DENSE_BLOCK; i++) sample_times[i] = (k + i + 1) * tau_s;
+        dopri.integrateDense(continuous, k * tau_s, x_dense, &sample_times[0], DENSE_BLOCK, &dense_out[0]);
+        bench_sink = dense_out[0];
+    }, steps, overhead));
+    
+    // Evaluaciones de f por muestra y diferencia maxima entre ambos metodos sobre la
+    // misma corrida desde el reposo
+    int dense_samples = steps - steps % DENSE_BLOCK;
+    double x_ref[3] = {0.0, 0.0, 0.0};
+    vector<double> step_states(dense_samples * 3);
+    dopri.setStepSizeHint(0.0);
+    dopri.resetCounters();
+    for (int k = 0; k < dense_samples; k++) {
+        dopri.advance(continuous, k * tau_s, (k + 1) * tau_s, x_ref);
+        copy(x_ref, x_ref + 3, &step_states[k * 3]);
+    }
+    double step_evals = (double)dopri.functionEvaluations() / max(1, dense_samples);
+    
+    fill(x_dense, x_dense + 3, 0.0);
+    dopri.setStepSizeHint(0.0);
+    dopri.resetCounters();
+    double dense_error = 0.0;
+    for (int k = 0; k < dense_samples; k += DENSE_BLOCK) {
+        for (int i = 0; i < DENSE_BLOCK; i++) sample_times[i] = (k + i + 1) * tau_s;
+        dopri.integrateDense(continuous, k * tau_s, x_dense, &sample_times[0], DENSE_BLOCK, &dense_out[0]);
+        for (int i = 0; i < DENSE_BLOCK * 3; i++) {
+            dense_error = max(dense_error, fabs(dense_out[i] - step_states[k * 3 + i]));
+        }
+    }
+    double dense_evals = (double)dopri.functionEvaluations() / max(1, dense_samples);
+    
+    {
+        HighOrderDerivator d;
+        Plant p;
+        SineSource source;
+        results.push_back(benchmarkStep("Lazo completo<double> (senoidal)", [&](int) {
+            d.update(source.next());
+            bench_sink = p.update(d.getZ0());
+        }, steps, overhead));
+    }
+    {
+        BasicHighOrderDerivator<float> d;
+        BasicPlant<float> p;
+        SineSource source;
+        results.push_back(benchmarkStep("Lazo completo<float> (senoidal)", [&](int) {
+            d.update((float)source.next());
+            bench_sink = p.update(d.getZ0());
+        }, steps, overhead));
+    }
+    
+    if (csv) {
+        cout << "kernel,ns_por_muestra,mediana_ns,p99_ns,max_ns" << endl;
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            cout << r.name << "," << fixed << setprecision(2) << r.mean_ns << ","
+                 << r.median_ns << "," << r.p99_ns << "," << r.max_ns << endl;
+        }
+        cout << "\nmetodo,f_por_muestra,diferencia_max" << endl;
+        cout << "paso_por_muestra," << setprecision(3) << step_evals << ",0" << endl;
+        cout << "salida_densa," << dense_evals << "," << scientific << dense_error << endl;
+        return 0;
+    }
+    
+    cout << "\n+============================================================+" << endl;
+    cout << "|        BENCHMARK DEL KERNEL HIL (sin E/S)                  |" << endl;
+    cout << "+============================================================+" << endl;
+    cout << "- Muestras por caso: " << steps << endl;
+    cout << fixed << setprecision(0);
+    cout << "- Costo del reloj descontado: " << overhead << " ns" << endl;
+    cout << "- Presupuesto de tiempo real: " << tau_s * 1e9 << " ns por muestra\n" << endl;
+    
+    cout << left << setw(48) << "Kernel" << right
+         << setw(10) << "ns/mues" << setw(10) << "mediana" << setw(10) << "p99" << setw(12) << "max" << endl;
+    cout << string(90, '-') << endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        cout << left << setw(48) << r.name << right << fixed << setprecision(1)
+             << setw(10) << r.mean_ns << setw(10) << r.median_ns
+             << setw(10) << r.p99_ns << setw(12) << r.max_ns << endl;
+    }
+    
+    cout << "\nEntrada continua u(t) = sin(pi t), Dormand-Prince (rtol 1e-6):" << endl;
+    cout << setprecision(2);
+    cout << "- Paso por muestra (advance):       " << step_evals << " evaluaciones de f por muestra" << endl;
+    cout << "- Salida densa (" << DENSE_BLOCK << " muestras/bloque): " << dense_evals
+         << " evaluaciones de f por muestra" << endl;
+    cout << "- Diferencia maxima de estado entre ambos: " << scientific << dense_error << endl;
+    cout << endl;
+    return 0;
+}
+
+#else
+
+// Lee el tiempo de simulacion (5-100 s) desde consola
+double askSimulationTime() {
+    double simTime;
+    bool validTime = false;
+    
+    do {
+        cout << "\n-> Ingrese el tiempo de simulacion en segundos (5-100): ";
+        cin >> simTime;
+        
+        if (cin.fail() || simTime < 5 || simTime > 100) {
+            cin.clear();
+            cin.ignore(10000, '\n');
+            cout << "[X] Tiempo invalido. Debe estar entre 5 y 100 segundos." << endl;
+        } else {
+            validTime = true;
+        }
+    } while (!validTime);
+    
+    return simTime;
+}
+
+// Lee un valor en [lo, hi] desde consola, repitiendo la pregunta hasta que sea valido
+template <class T>
+T askValue(const string& prompt, T lo, T hi) {
+    T value;
+    bool valid = false;
+    
+    do {
+        cout << prompt;
+        cin >> value;
+        
+        if (cin.fail() || value < lo || value > hi) {
+            cin.clear();
+            cin.ignore(10000, '\n');
+            cout << "[X] Valor invalido. Debe estar entre " << lo << " y " << hi << "." << endl;
+        } else {
+            valid = true;
+        }
+    } while (!valid);
     
+    return value;
+}
+
+// Lee la decimacion del registro y, si se decima, los umbrales de disparo
+TraceLogConfig askTraceLogConfig() {
+    TraceLogConfig config;
+    config.decimation = askValue<int>(
+        "\n-> Muestras por fila del registro (1 = todas, 2-250 = media y min/max por ventana): ", 1, 250);
+    if (config.decimation > 1) {
+        config.errorThreshold = askValue<double>(
+            "-> Umbral |z0 - f| para registrar a tasa completa (0 = sin disparo): ", 0.0, 1e6);
+        config.slopeThreshold = askValue<double>(
+            "-> Umbral |z1| para registrar a tasa completa (0 = sin disparo): ", 0.0, 1e6);
+    }
+    return config;
+}
+
+// Lee el tipo de senal de referencia (1-6); con la opcion 6 tambien la ruta de la traza
+int askSignalType(string& tracePath) {
     int option;
     bool validOption = false;
     
@@ -289,45 +1949,187 @@ int main() {
         cout << "  1. Senal Escalon Unitario" << endl;
         cout << "  2. Senal Rampa" << endl;
         cout << "  3. Senal Senoidal" << endl;
-        cout << "\n-> Ingrese su opcion (1-3): ";
+        cout << "  4. Senal Chirp (barrido 0.1 - 5 Hz)" << endl;
+        cout << "  5. Senal PRBS (binaria pseudoaleatoria)" << endl;
+        cout << "  6. Reproducir traza registrada (archivo)" << endl;
+        cout << "\n-> Ingrese su opcion (1-6): ";
         
         cin >> option;
         
-        if (cin.fail() || option < 1 || option > 3) {
+        if (cin.fail() || option < 1 || option > 6) {
             cin.clear();
             cin.ignore(10000, '\n');
-            cout << "\n[X] Opcion invalida. Por favor ingrese 1, 2 o 3.\n" << endl;
+            cout << "\n[X] Opcion invalida. Por favor ingrese un valor entre 1 y 6.\n" << endl;
         } else {
             validOption = true;
         }
     } while (!validOption);
     
-    double simTime;
-    bool validTime = false;
+    tracePath.clear();
+    if (option == 6) {
+        bool validTrace = false;
+        do {
+            cout << "\n-> Ingrese la ruta de la traza (un valor por linea o CSV): ";
+            cin >> tracePath;
+            
+            ifstream probe(tracePath);
+            if (cin.fail() || !probe.is_open()) {
+                cin.clear();
+                cin.ignore(10000, '\n');
+                cout << "[X] No se pudo abrir el archivo " << tracePath << endl;
+            } else {
+                validTrace = true;
+            }
+        } while (!validTrace);
+    }
+    
+    return option;
+}
+
+// Lee el metodo de integracion de la planta (1-3)
+int askIntegratorType() {
+    int integratorType;
+    bool validIntegrator = false;
     
     do {
-        cout << "\n-> Ingrese el tiempo de simulacion en segundos (5-100): ";
-        cin >> simTime;
+        cout << "\n+============================================+" << endl;
+        cout << "|  SELECCIONE EL METODO DE INTEGRACION       |" << endl;
+        cout << "+============================================+" << endl;
+        cout << "  1. Runge-Kutta 4 (precalculado, paso fijo)" << endl;
+        cout << "  2. Dormand-Prince 5(4) (paso adaptativo)" << endl;
+        cout << "  3. TR-BDF2 (implicito, modelos rigidos)" << endl;
+        cout << "\n-> Ingrese su opcion (1-3): ";
         
-        if (cin.fail() || simTime < 5 || simTime > 100) {
+        cin >> integratorType;
+        
+        if (cin.fail() || integratorType < 1 || integratorType > 3) {
             cin.clear();
             cin.ignore(10000, '\n');
-            cout << "[X] Tiempo invalido. Debe estar entre 5 y 100 segundos." << endl;
+            cout << "\n[X] Opcion invalida. Por favor ingrese 1, 2 o 3.\n" << endl;
         } else {
-            validTime = true;
+            validIntegrator = true;
         }
-    } while (!validTime);
+    } while (!validIntegrator);
+    
+    return integratorType;
+}
+
+// Configura y ejecuta una simulacion nueva; retorna el archivo de salida
+string newSimulation() {
+    string tracePath;
+    int option = askSignalType(tracePath);
+    int integratorType = askIntegratorType();
+    
+    double simTime = askSimulationTime();
+    TraceLogConfig logConfig = askTraceLogConfig();
     
     // Generar nombre de archivo segun el tipo de senal
     string filename;
     if (option == 1) filename = "hil_escalon_output.txt";
     else if (option == 2) filename = "hil_rampa_output.txt";
-    else filename = "hil_senoidal_output.txt";
+    else if (option == 3) filename = "hil_senoidal_output.txt";
+    else if (option == 4) filename = "hil_chirp_output.txt";
+    else if (option == 5) filename = "hil_prbs_output.txt";
+    else filename = "hil_traza_output.txt";
     
     cout << "\n" << endl;
     
     // Ejecutar simulacion HIL
-    runHILSimulation(option, simTime, filename);
+    runHILSimulation(option, simTime, filename, integratorType, tracePath, nullptr, logConfig);
+    return filename;
+}
+
+// Continua una corrida desde un checkpoint, en la misma traza o en una rama nueva.
+// La misma traza solo se continua desde su ultimo checkpoint (<archivo>.ckpt); desde
+// una instantanea anterior (<archivo>.t<seg>.ckpt) siempre se crea una rama, que puede
+// cambiar la senal, el integrador y el registro. Cada reanudacion agrega hasta 100 s,
+// sin re-simular el prefijo.
+string resumeSimulation() {
+    HILCheckpoint checkpoint;
+    string checkpointPath;
+    bool validCheckpoint = false;
+    
+    do {
+        cout << "\n-> Ingrese la ruta del checkpoint (.ckpt): ";
+        cin >> checkpointPath;
+        
+        if (cin.fail() || !loadCheckpoint(checkpointPath, checkpoint)) {
+            cin.clear();
+            cin.ignore(10000, '\n');
+            cout << "[X] Checkpoint invalido o inexistente: " << checkpointPath << endl;
+        } else {
+            validCheckpoint = true;
+        }
+    } while (!validCheckpoint);
+    
+    cout << "[OK] Checkpoint en t = " << formatSeconds(checkpoint.sample) << " s, traza: "
+         << checkpoint.traceFile << endl;
+    
+    HILCheckpoint latest;
+    bool isLatest = loadCheckpoint(latestCheckpointPath(checkpoint.traceFile), latest) &&
+                    latest.sample == checkpoint.sample && latest.tracePos == checkpoint.tracePos;
+    
+    int branchOption = 2;
+    if (isLatest) {
+        cout << "\n  1. Continuar la misma traza" << endl;
+        cout << "  2. Crear una rama nueva desde este estado" << endl;
+        branchOption = askValue<int>("\n-> Ingrese su opcion (1-2): ", 1, 2);
+    } else {
+        cout << "[INFO] No es el ultimo checkpoint de la traza: se crea una rama nueva" << endl;
+    }
+    
+    int signalType = checkpoint.signalType;
+    int integratorType = checkpoint.integratorType;
+    string tracePath = checkpoint.tracePath;
+    TraceLogConfig logConfig = checkpoint.logger.config;
+    string filename = checkpoint.traceFile;
+    if (branchOption == 2) {
+        cout << "\n  1. Mantener senal, integrador y registro" << endl;
+        cout << "  2. Cambiarlos para esta rama" << endl;
+        if (askValue<int>("\n-> Ingrese su opcion (1-2): ", 1, 2) == 2) {
+            cout << endl;
+            signalType = askSignalType(tracePath);
+            integratorType = askIntegratorType();
+            logConfig = askTraceLogConfig();
+        }
+        filename = branchFileName(checkpoint.traceFile, checkpoint.sample);
+    }
+    
+    double simTime = askSimulationTime();
+    
+    cout << "\n" << endl;
+    
+    runHILSimulation(signalType, simTime, filename, integratorType, tracePath, &checkpoint, logConfig);
+    return filename;
+}
+
+int main() {
+    cout << "\n+==============================================================+" << endl;
+    cout << "|     TRABAJO PRACTICO No. 4 - Punto 2 (50%)                  |" << endl;
+    cout << "|     Sistema HIL: Planta SISO + Derivador Orden Superior    |" << endl;
+    cout << "|     Programacion Avanzada - Ing. Mecatronica               |" << endl;
+    cout << "+==============================================================+\n" << endl;
+    
+    int mode;
+    bool validMode = false;
+    
+    do {
+        cout << "  1. Nueva simulacion" << endl;
+        cout << "  2. Reanudar desde checkpoint" << endl;
+        cout << "\n-> Ingrese su opcion (1-2): ";
+        
+        cin >> mode;
+        
+        if (cin.fail() || mode < 1 || mode > 2) {
+            cin.clear();
+            cin.ignore(10000, '\n');
+            cout << "\n[X] Opcion invalida. Por favor ingrese 1 o 2.\n" << endl;
+        } else {
+            validMode = true;
+        }
+    } while (!validMode);
+    
+    string filename = (mode == 2) ? resumeSimulation() : newSimulation();
     
     cout << "Puede analizar los resultados con Python, MATLAB o Excel." << endl;
     cout << "Ejemplo Python:" << endl;
@@ -342,4 +2144,6 @@ int main() {
     cin.get();
     
     return 0;
-}
\ No newline at end of file
+}
+
+#endif
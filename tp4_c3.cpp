@@ -5,228 +5,2711 @@
 #include <random>
 #include <iomanip>
 #include <string>
+#include <cstdlib>
+#include <new>
+#define NOMINMAX
 #include <windows.h>
 #include <chrono>
 #include <thread>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <atomic>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
+#ifdef NN_BENCHMARK
+// Asignaciones de memoria dinamica del programa (operator new y AlignedAllocator),
+// contadas para el benchmark
+atomic<long long> nn_allocations(0);
+
+// GCC ve free sobre memoria de operator new, pero este operator new usa malloc
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    nn_allocations++;
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+// Version con tamano (C++14): sin ella -Wsized-deallocation avisa y los delete con
+// tamano usarian la del runtime
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+#endif
+
 // Función de activación sigmoide
-double sigmoid(double x) {
-    return 1.0 / (1.0 + exp(-x));
+template <class Real>
+Real sigmoid(Real x) {
+    return Real(1) / (Real(1) + exp(-x));
+}
+
+// Derivada de la función sigmoide
+template <class Real>
+Real sigmoid_derivative(Real x) {
+    return x * (Real(1) - x);
+}
+
+// Función para pausar la ejecución
+void pausar(int milisegundos) {
+    this_thread::sleep_for(chrono::milliseconds(milisegundos));
+}
+
+// Alineacion de los buffers de la red: una linea de cache (y un registro AVX-512)
+const size_t NN_ALIGNMENT = 64;
+
+// Asignador con memoria alineada a NN_ALIGNMENT para los buffers contiguos de la red
+template <class T>
+struct AlignedAllocator {
+    typedef T value_type;
+    
+    AlignedAllocator() {}
+    template <class U> AlignedAllocator(const AlignedAllocator<U>&) {}
+    
+    T* allocate(size_t count) {
+#ifdef NN_BENCHMARK
+        nn_allocations++;
+#endif
+        void* p = nullptr;
+#ifdef _WIN32
+        p = _aligned_malloc(count * sizeof(T), NN_ALIGNMENT);
+#else
+        if (posix_memalign(&p, NN_ALIGNMENT, count * sizeof(T)) != 0) p = nullptr;
+#endif
+        if (p == nullptr) throw bad_alloc();
+        return static_cast<T*>(p);
+    }
+    
+    void deallocate(T* p, size_t) {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+    
+    template <class U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template <class U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template <class T>
+using BasicAlignedVector = vector<T, AlignedAllocator<T>>;
+typedef BasicAlignedVector<double> AlignedVector;
+
+// Numero de elementos de tipo T por fila para que cada fila empiece alineada
+template <class T = double>
+inline int paddedStride(int cols) {
+    int lanes = (int)(NN_ALIGNMENT / sizeof(T));
+    return (cols + lanes - 1) / lanes * lanes;
+}
+
+// Kernels densos sobre buffers contiguos. Los bucles internos usan 8 acumuladores
+// independientes sobre datos contiguos, un patron que el compilador vectoriza con
+// SIMD (SSE2/AVX) al compilar con -O3; el resto se procesa en escalar.
+const int NN_LANES = 8;
+
+// Producto punto a . b de n elementos
+template <class T>
+inline T dotKernel(const T* a, const T* b, int n) {
+    T acc[NN_LANES] = {T(0)};
+    int i = 0;
+    for (; i + NN_LANES <= n; i += NN_LANES) {
+        for (int l = 0; l < NN_LANES; l++) acc[l] += a[i + l] * b[i + l];
+    }
+    T sum = T(0);
+    for (int l = 0; l < NN_LANES; l++) sum += acc[l];
+    for (; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+// y += alpha * x
+template <class T>
+inline void axpyKernel(T alpha, const T* x, T* y, int n) {
+    for (int i = 0; i < n; i++) y[i] += alpha * x[i];
+}
+
+// y = W x + b, con W de rows x cols en orden por filas (stride ld)
+template <class T>
+inline void gemvKernel(const T* W, int rows, int cols, int ld, const T* x, const T* b, T* y) {
+    for (int r = 0; r < rows; r++) {
+        y[r] = b[r] + dotKernel(W + (size_t)r * ld, x, cols);
+    }
+}
+
+// y = W^T d: suma de filas de W escaladas, recorriendo W por filas contiguas
+template <class T>
+inline void gemvTransposedKernel(const T* W, int rows, int cols, int ld, const T* d, T* y) {
+    for (int c = 0; c < cols; c++) y[c] = T(0);
+    for (int r = 0; r < rows; r++) {
+        axpyKernel(d[r], W + (size_t)r * ld, y, cols);
+    }
+}
+
+// W += alpha * d x^T (producto exterior, actualizacion de rango 1)
+template <class T>
+inline void gerKernel(T* W, int rows, int cols, int ld, T alpha, const T* d, const T* x) {
+    for (int r = 0; r < rows; r++) {
+        axpyKernel(alpha * d[r], x, W + (size_t)r * ld, cols);
+    }
+}
+
+// Precision de sigmoidKernel, con el error absoluto maximo respecto a la sigmoide
+// exacta en double medido sobre [-50, 50] (ver clasificador --sigmoid)
+enum SigmoidAccuracy {
+    SIGMOID_EXACT,   // 1 / (1 + exp(-x)) con exp de la biblioteca (referencia)
+    SIGMOID_FAST,    // Grado 11 en double: < 3e-15; grado 6 en float: < 2e-7, como la exacta
+    SIGMOID_FASTEST  // Grado 3: < 2e-4
+};
+
+// exp(x) sin ramas ni llamadas para que los bucles que la usan se vectoricen:
+// x = n ln2 + r con |r| <= ln2 / 2, exp(r) con el polinomio de Taylor de grado Degree
+// y 2^n armado directamente en los bits del exponente. Sumar 1.5 * 2^52 redondea
+// x / ln2 al entero n y lo deja en los bits bajos de la mantisa.
+template <int Degree>
+inline double fastExp(double x) {
+    const double shifter = 6755399441055744.0;  // 1.5 * 2^52
+    x = min(700.0, max(-700.0, x));
+    double t = x * 1.4426950408889634 + shifter;
+    double n = t - shifter;
+    double r = x - n * 0.6931471805599453;
+    
+    double p = 1.0;
+    for (int k = Degree; k >= 1; k--) p = 1.0 + r * p * (1.0 / k);
+    
+    uint64_t bits;
+    memcpy(&bits, &t, sizeof(bits));
+    bits = (bits + 1023) << 52;
+    double scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+template <int Degree>
+inline float fastExp(float x) {
+    const float shifter = 12582912.0f;  // 1.5 * 2^23
+    x = min(87.0f, max(-87.0f, x));
+    float t = x * 1.44269504f + shifter;
+    float n = t - shifter;
+    float r = x - n * 0.693147181f;
+    
+    float p = 1.0f;
+    for (int k = Degree; k >= 1; k--) p = 1.0f + r * p * (1.0f / k);
+    
+    uint32_t bits;
+    memcpy(&bits, &t, sizeof(bits));
+    bits = (bits + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// Aplica la sigmoide en su lugar a n valores contiguos
+template <class T>
+inline void sigmoidKernel(T* x, int n, SigmoidAccuracy accuracy) {
+    switch (accuracy) {
+        case SIGMOID_FAST:
+            for (int i = 0; i < n; i++) {
+                x[i] = T(1) / (T(1) + fastExp<sizeof(T) == sizeof(double) ? 11 : 6>(-x[i]));
+            }
+            break;
+        case SIGMOID_FASTEST:
+            for (int i = 0; i < n; i++) x[i] = T(1) / (T(1) + fastExp<3>(-x[i]));
+            break;
+        default:
+            for (int i = 0; i < n; i++) x[i] = sigmoid(x[i]);
+            break;
+    }
+}
+
+// Funcion de activacion de una capa densa
+enum Activation {
+    ACT_SIGMOID,
+    ACT_RELU,
+    ACT_TANH,
+    ACT_SOFTMAX  // Solo en la capa de salida; se entrena con entropia cruzada
+};
+
+// Nombre de una activacion, tal como se escribe en --capas
+inline const char* activationName(Activation activation) {
+    switch (activation) {
+        case ACT_SIGMOID: return "sigmoid";
+        case ACT_RELU: return "relu";
+        case ACT_TANH: return "tanh";
+        case ACT_SOFTMAX: return "softmax";
+        default: return "desconocida";
+    }
+}
+
+// exp en su lugar sobre n valores, con la precision elegida
+template <class T>
+inline void expKernel(T* x, int n, SigmoidAccuracy accuracy) {
+    switch (accuracy) {
+        case SIGMOID_FAST:
+            for (int i = 0; i < n; i++) x[i] = fastExp<sizeof(T) == sizeof(double) ? 11 : 6>(x[i]);
+            break;
+        case SIGMOID_FASTEST:
+            for (int i = 0; i < n; i++) x[i] = fastExp<3>(x[i]);
+            break;
+        default:
+            for (int i = 0; i < n; i++) x[i] = exp(x[i]);
+            break;
+    }
+}
+
+// Aplica la activacion en su lugar a rows filas de cols valores (stride ld). Las
+// activaciones por elemento recorren el bloque completo, relleno incluido (ninguna
+// operacion lee las columnas de relleno); softmax se normaliza por fila. tanh usa
+// tanh(x) = 2 sigmoide(2x) - 1, con la misma precision que la sigmoide.
+template <class T>
+inline void activationKernel(T* x, int rows, int cols, int ld, Activation activation,
+                             SigmoidAccuracy accuracy) {
+    int n = (rows - 1) * ld + cols;
+    switch (activation) {
+        case ACT_RELU:
+            for (int i = 0; i < n; i++) x[i] = max(T(0), x[i]);
+            break;
+        case ACT_TANH:
+            if (accuracy == SIGMOID_EXACT) {
+                for (int i = 0; i < n; i++) x[i] = tanh(x[i]);
+                break;
+            }
+            for (int i = 0; i < n; i++) x[i] = T(2) * x[i];
+            sigmoidKernel(x, n, accuracy);
+            for (int i = 0; i < n; i++) x[i] = T(2) * x[i] - T(1);
+            break;
+        case ACT_SOFTMAX:
+            for (int r = 0; r < rows; r++) {
+                T* row = x + (size_t)r * ld;
+                T row_max = *max_element(row, row + cols);
+                for (int j = 0; j < cols; j++) row[j] -= row_max;
+                expKernel(row, cols, accuracy);
+                T sum = T(0);
+                for (int j = 0; j < cols; j++) sum += row[j];
+                T inv = T(1) / sum;
+                for (int j = 0; j < cols; j++) row[j] *= inv;
+            }
+            break;
+        default:
+            sigmoidKernel(x, n, accuracy);
+            break;
+    }
+}
+
+// d *= f'(a) para n valores, con la derivada expresada con la salida a = f(z)
+template <class T>
+inline void activationDerivativeKernel(const T* a, T* d, int n, Activation activation) {
+    switch (activation) {
+        case ACT_RELU:
+            for (int i = 0; i < n; i++) d[i] = (a[i] > T(0)) ? d[i] : T(0);
+            break;
+        case ACT_TANH:
+            for (int i = 0; i < n; i++) d[i] *= T(1) - a[i] * a[i];
+            break;
+        default:
+            for (int i = 0; i < n; i++) d[i] *= sigmoid_derivative(a[i]);
+            break;
+    }
+}
+
+// Matriz densa en orden por filas sobre un buffer alineado (una muestra por fila)
+template <class T>
+struct BasicMatrix {
+    int rows;
+    int cols;
+    int ld;  // Stride entre filas
+    BasicAlignedVector<T> data;
+    
+    BasicMatrix() : rows(0), cols(0), ld(0) {}
+    BasicMatrix(int rows_, int cols_)
+        : rows(rows_), cols(cols_), ld(paddedStride<T>(cols_)),
+          data((size_t)rows_ * paddedStride<T>(cols_), T(0)) {}
+    
+    T* row(int i) { return &data[(size_t)i * ld]; }
+    const T* row(int i) const { return &data[(size_t)i * ld]; }
+    T& operator()(int i, int j) { return data[(size_t)i * ld + j]; }
+    T operator()(int i, int j) const { return data[(size_t)i * ld + j]; }
+    
+    // Cambia la forma conservando la memoria: solo asigna si la capacidad no alcanza
+    void resize(int rows_, int cols_) {
+        rows = rows_;
+        cols = cols_;
+        ld = paddedStride<T>(cols_);
+        size_t needed = (size_t)rows_ * ld;
+        if (data.size() < needed) data.resize(needed, T(0));
+    }
+};
+
+typedef BasicMatrix<double> Matrix;
+
+// Copia src en dst convirtiendo el tipo de los elementos
+template <class T, class U>
+void convertMatrix(const BasicMatrix<T>& src, BasicMatrix<U>& dst) {
+    dst.resize(src.rows, src.cols);
+    for (int i = 0; i < src.rows; i++) {
+        const T* in = src.row(i);
+        U* out = dst.row(i);
+        for (int j = 0; j < src.cols; j++) out[j] = U(in[j]);
+    }
+}
+
+// Filas de B procesadas por bloque en gemmNTKernel (un bloque de B cabe en cache L1)
+const int NN_GEMM_BLOCK = 32;
+
+// C = A B^T + bias (bias por columna). A: m x k, B: n x k, C: m x n.
+// Con B = pesos (una fila por neurona) calcula la propagacion de un lote completo.
+template <class T>
+inline void gemmNTKernel(const T* A, int lda, const T* B, int ldb, const T* bias,
+                         T* C, int ldc, int m, int n, int k) {
+    for (int j0 = 0; j0 < n; j0 += NN_GEMM_BLOCK) {
+        int j1 = min(n, j0 + NN_GEMM_BLOCK);
+        for (int i = 0; i < m; i++) {
+            const T* a = A + (size_t)i * lda;
+            T* c = C + (size_t)i * ldc;
+            for (int j = j0; j < j1; j++) {
+                c[j] = bias[j] + dotKernel(a, B + (size_t)j * ldb, k);
+            }
+        }
+    }
+}
+
+// C = A B. A: m x k, B: k x n, C: m x n (cada fila de C es combinacion de filas de B)
+template <class T>
+inline void gemmNNKernel(const T* A, int lda, const T* B, int ldb, T* C, int ldc, int m, int n, int k) {
+    for (int i = 0; i < m; i++) {
+        T* c = C + (size_t)i * ldc;
+        for (int j = 0; j < n; j++) c[j] = T(0);
+        const T* a = A + (size_t)i * lda;
+        for (int p = 0; p < k; p++) {
+            axpyKernel(a[p], B + (size_t)p * ldb, c, n);
+        }
+    }
+}
+
+// C += alpha * A^T B. A: k x m, B: k x n, C: m x n (suma de k productos exteriores)
+template <class T>
+inline void gemmTNKernel(T alpha, const T* A, int lda, const T* B, int ldb,
+                         T* C, int ldc, int m, int n, int k) {
+    for (int p = 0; p < k; p++) {
+        const T* a = A + (size_t)p * lda;
+        const T* b = B + (size_t)p * ldb;
+        for (int i = 0; i < m; i++) {
+            axpyKernel(alpha * a[i], b, C + (size_t)i * ldc, n);
+        }
+    }
+}
+
+// Optimizador de los pesos. Todos reciben la direccion de descenso g (menos el
+// gradiente medio) y guardan su estado en buffers planos con la misma distribucion
+// que el buffer de parametros.
+enum OptimizerKind {
+    OPT_SGD,       // w += lr g
+    OPT_MOMENTUM,  // v = mu v + g; w += lr v
+    OPT_NESTEROV,  // v = mu v + g; w += lr (g + mu v)
+    OPT_ADAM       // Momentos de primer y segundo orden con correccion de sesgo
+};
+
+// Programa de la tasa de aprendizaje, evaluado al inicio de cada epoca
+enum LearningRateSchedule {
+    LR_CONSTANT,
+    LR_STEP,    // lr * step_factor ^ (epoca / step_epochs)
+    LR_COSINE   // De lr a lr * min_factor en cosine_epochs epocas (medio coseno)
+};
+
+struct OptimizerConfig {
+    OptimizerKind kind;
+    LearningRateSchedule schedule;
+    double momentum;            // OPT_MOMENTUM y OPT_NESTEROV
+    double beta1, beta2;        // OPT_ADAM
+    double epsilon;
+    int step_epochs;            // LR_STEP
+    double step_factor;
+    int cosine_epochs;          // LR_COSINE
+    double min_factor;
+};
+
+// Configuracion con los valores habituales de cada optimizador y tasa constante
+inline OptimizerConfig defaultOptimizer(OptimizerKind kind = OPT_SGD) {
+    OptimizerConfig config;
+    config.kind = kind;
+    config.schedule = LR_CONSTANT;
+    config.momentum = 0.9;
+    config.beta1 = 0.9;
+    config.beta2 = 0.999;
+    config.epsilon = 1e-8;
+    config.step_epochs = 100;
+    config.step_factor = 0.5;
+    config.cosine_epochs = 1000;
+    config.min_factor = 0.01;
+    return config;
+}
+
+// Nombres de optimizadores y programas, tal como se escriben en la linea de comandos
+inline const char* optimizerName(OptimizerKind kind) {
+    switch (kind) {
+        case OPT_SGD: return "sgd";
+        case OPT_MOMENTUM: return "momentum";
+        case OPT_NESTEROV: return "nesterov";
+        case OPT_ADAM: return "adam";
+        default: return "desconocido";
+    }
+}
+
+inline const char* scheduleName(LearningRateSchedule schedule) {
+    switch (schedule) {
+        case LR_CONSTANT: return "constante";
+        case LR_STEP: return "escalon";
+        case LR_COSINE: return "coseno";
+        default: return "desconocido";
+    }
+}
+
+// Tasa de aprendizaje de la epoca dada (desde 0) segun el programa
+inline double scheduledLearningRate(const OptimizerConfig& config, double base, long long epoch) {
+    switch (config.schedule) {
+        case LR_STEP:
+            return base * pow(config.step_factor, (double)(epoch / max(1, config.step_epochs)));
+        case LR_COSINE: {
+            double t = min(1.0, (double)epoch / max(1, config.cosine_epochs));
+            double low = base * config.min_factor;
+            return low + 0.5 * (base - low) * (1.0 + cos(3.14159265358979323846 * t));
+        }
+        default:
+            return base;
+    }
+}
+
+// Valores de estado por parametro que necesita cada optimizador
+inline int optimizerStateCount(OptimizerKind kind) {
+    switch (kind) {
+        case OPT_MOMENTUM:
+        case OPT_NESTEROV: return 1;
+        case OPT_ADAM: return 2;
+        default: return 0;
+    }
+}
+
+// Pasos de los optimizadores sobre n parametros, con la direccion g escalada por
+// scale (1 / muestras del lote). Como axpyKernel, son bucles simples sobre datos
+// contiguos que el compilador vectoriza.
+template <class T>
+inline void momentumKernel(T* w, T* v, const T* g, int n, T lr, T mu, T scale, bool nesterov) {
+    if (nesterov) {
+        for (int i = 0; i < n; i++) {
+            T gi = scale * g[i];
+            v[i] = mu * v[i] + gi;
+            w[i] += lr * (gi + mu * v[i]);
+        }
+    } else {
+        for (int i = 0; i < n; i++) {
+            v[i] = mu * v[i] + scale * g[i];
+            w[i] += lr * v[i];
+        }
+    }
+}
+
+// Adam con la correccion de sesgo aplicada a la tasa: lr_t = lr sqrt(1 - b2^t) / (1 - b1^t)
+template <class T>
+inline void adamKernel(T* w, T* m, T* v, const T* g, int n, T lr_t, T beta1, T beta2, T epsilon,
+                       T scale) {
+    for (int i = 0; i < n; i++) {
+        T gi = scale * g[i];
+        m[i] = beta1 * m[i] + (T(1) - beta1) * gi;
+        v[i] = beta2 * v[i] + (T(1) - beta2) * gi * gi;
+        w[i] += lr_t * m[i] / (sqrt(v[i]) + epsilon);
+    }
+}
+
+// Archivo proyectado en memoria de solo lectura (mmap / CreateFileMapping)
+class MappedFile {
+private:
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE map_handle;
+#endif
+    
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+    
+public:
+    MappedFile() : data_(nullptr), size_(0) {
+#ifdef _WIN32
+        file_handle = INVALID_HANDLE_VALUE;
+        map_handle = NULL;
+#endif
+    }
+    
+    ~MappedFile() { close(); }
+    
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file_handle == INVALID_HANDLE_VALUE) return false;
+        
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_handle, &file_size)) { close(); return false; }
+        size_ = (size_t)file_size.QuadPart;
+        if (size_ == 0) return true;
+        
+        map_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map_handle == NULL) { close(); return false; }
+        data_ = (const char*)MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+        if (data_ == nullptr) { close(); return false; }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        
+        struct stat st;
+        if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+        size_ = (size_t)st.st_size;
+        if (size_ == 0) { ::close(fd); return true; }
+        
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) { size_ = 0; return false; }
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = (const char*)p;
+#endif
+        return true;
+    }
+    
+    void close() {
+#ifdef _WIN32
+        if (data_ != nullptr) UnmapViewOfFile(data_);
+        if (map_handle != NULL) CloseHandle(map_handle);
+        if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+        map_handle = NULL;
+        file_handle = INVALID_HANDLE_VALUE;
+#else
+        if (data_ != nullptr) munmap((void*)data_, size_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+    
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+};
+
+// Conjunto fijo de hilos de trabajo. start reparte [0, count) en un bloque contiguo
+// por hilo y retorna de inmediato; wait espera a que todos terminen. Los hilos se
+// crean una sola vez.
+class ThreadPool {
+private:
+    vector<thread> workers;
+    mutex m;
+    condition_variable work_ready;
+    condition_variable work_done;
+    
+    // Trabajo actual: funcion (contexto, inicio, fin, indice del hilo) y su contexto. Los
+    // hilos llaman al invocable del llamador en su lugar, sin copiarlo ni asignar memoria.
+    typedef void (*JobFunction)(void*, int, int, int);
+    JobFunction job;
+    void* job_context;
+    int job_count;
+    int generation;
+    int pending;
+    bool stopping;
+    
+    void workerLoop(int worker) {
+        int seen = 0;
+        while (true) {
+            JobFunction task;
+            void* context;
+            int count;
+            {
+                unique_lock<mutex> lock(m);
+                work_ready.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                task = job;
+                context = job_context;
+                count = job_count;
+            }
+            
+            int threads = (int)workers.size();
+            int begin = (int)((long long)count * worker / threads);
+            int end = (int)((long long)count * (worker + 1) / threads);
+            if (begin < end) task(context, begin, end, worker);
+            
+            unique_lock<mutex> lock(m);
+            if (--pending == 0) work_done.notify_one();
+        }
+    }
+    
+    template <class F>
+    static void invokeJob(void* context, int begin, int end, int worker) {
+        (*static_cast<F*>(context))(begin, end, worker);
+    }
+    
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+    
+public:
+    explicit ThreadPool(int threads)
+        : job(nullptr), job_context(nullptr), job_count(0), generation(0), pending(0), stopping(false) {
+        threads = max(1, threads);
+        for (int i = 0; i < threads; i++) {
+            workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+        }
+    }
+    
+    ~ThreadPool() {
+        {
+            unique_lock<mutex> lock(m);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+    }
+    
+    int size() const { return (int)workers.size(); }
+    
+    // Reparte fn(inicio, fin, hilo) sobre [0, count) sin esperar. fn se usa por
+    // referencia: debe seguir vivo hasta el wait() correspondiente.
+    template <class F>
+    void start(int count, F& fn) {
+        unique_lock<mutex> lock(m);
+        work_done.wait(lock, [&] { return pending == 0; });
+        job = &invokeJob<F>;
+        job_context = (void*)&fn;
+        job_count = count;
+        pending = (int)workers.size();
+        generation++;
+        work_ready.notify_all();
+    }
+    
+    void wait() {
+        unique_lock<mutex> lock(m);
+        work_done.wait(lock, [&] { return pending == 0; });
+    }
+    
+    template <class F>
+    void parallelFor(int count, F&& fn) {
+        start(count, fn);
+        wait();
+    }
+};
+
+// Formato binario del modelo entrenado (version 3): una cabecera de 64 bytes, la
+// tabla de capas (tamano y activacion de cada una) y, desde el siguiente multiplo de
+// NN_ALIGNMENT, el buffer de parametros tal como esta en memoria (W y b de cada capa
+// con sus strides), de modo que la red lo usa directamente desde la proyeccion del
+// archivo. Los valores se guardan en el formato nativo de la maquina. La version 2
+// agrego el tamano del tipo escalar y la 3 la tabla de capas.
+const char NN_MODEL_MAGIC[8] = {'N', 'N', 'M', 'O', 'D', 'E', 'L', '\0'};
+const uint32_t NN_MODEL_VERSION = 3;
+const int NN_MAX_LAYERS = 64;
+const int NN_MAX_LAYER_SIZE = 1 << 20;
+
+struct ModelFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int32_t input_size;
+    int32_t layer_count;
+    int32_t scalar_size;    // sizeof del tipo escalar: 8 (double) o 4 (float)
+    int32_t reserved;
+    double learning_rate;
+    uint64_t param_offset;  // Desplazamiento de los parametros (multiplo de NN_ALIGNMENT)
+    uint64_t param_count;
+    uint64_t checksum;      // modelChecksum de la cabecera, la tabla de capas y los parametros
+};
+static_assert(sizeof(ModelFileHeader) == 64, "la cabecera del modelo debe ocupar 64 bytes");
+
+struct ModelLayerRecord {
+    int32_t size;
+    int32_t activation;
+};
+
+// FNV-1a de 64 bits sobre la cabecera (sin el campo checksum), la tabla de capas y,
+// por palabras de 8 bytes, sobre los parametros (bytes es multiplo de NN_ALIGNMENT)
+inline uint64_t modelChecksum(const ModelFileHeader& header, const ModelLayerRecord* layers,
+                              const void* params, size_t bytes) {
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t h = 14695981039346656037ULL;
+    const unsigned char* head = (const unsigned char*)&header;
+    for (size_t i = 0; i < offsetof(ModelFileHeader, checksum); i++) {
+        h = (h ^ head[i]) * prime;
+    }
+    const unsigned char* table = (const unsigned char*)layers;
+    for (size_t i = 0; i < header.layer_count * sizeof(ModelLayerRecord); i++) {
+        h = (h ^ table[i]) * prime;
+    }
+    const char* data = (const char*)params;
+    for (size_t i = 0; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ word) * prime;
+    }
+    return h;
+}
+
+// Semilla no determinista (random_device) para las redes creadas sin semilla explicita
+inline uint32_t randomSeed() {
+    random_device rd;
+    return rd();
+}
+
+// Clase para la Red Neuronal: una pila de capas densas de cualquier cantidad y tamano,
+// cada una con su activacion. sizes[0] es la entrada y sizes[l + 1] la salida de la
+// capa l. Todos los parametros viven en un unico buffer contiguo y alineado, con W y
+// b de cada capa en orden; W se guarda transpuesta respecto a [entrada][salida], de
+// modo que cada neurona recorre una fila contigua en la propagacion hacia adelante.
+// Las activaciones y deltas intermedios de una muestra viven en una sola arena, y los
+// de un lote en otra. Una red cargada con NeuralNetwork(ruta) usa los parametros
+// directamente desde el archivo proyectado y solo los copia a memoria propia si se
+// vuelve a entrenar. Real es el tipo escalar de parametros y activaciones.
+template <class Real>
+class BasicNeuralNetwork {
+private:
+    template <class> friend class BasicNeuralNetwork;
+    friend class QuantizedNetwork;
+
+    int layer_count;
+    vector<int> sizes;
+    vector<Activation> activations;
+
+    // Por capa: stride de las filas de W (= paddedStride de la entrada de la capa) y
+    // desplazamientos de W y b en el buffer de parametros
+    vector<int> ld;
+    vector<size_t> off_w, off_b;
+    size_t param_count;
+
+    BasicAlignedVector<Real> params;
+
+    // Parametros en uso: &params[0] o la proyeccion de un modelo guardado
+    const Real* weights;
+    MappedFile model_file;
+
+    Real learning_rate;  // Tasa base; el programa del optimizador la ajusta por epoca
+    SigmoidAccuracy sigmoid_accuracy;
+    mt19937 rng;
+
+    // Optimizador: estado de optimizerStateCount(kind) buffers de param_count valores
+    // (velocidad, o primer y segundo momento de Adam), pasos dados y epocas entrenadas
+    OptimizerConfig optimizer;
+    BasicAlignedVector<Real> opt_state;
+    long long opt_steps;
+    long long opt_epoch;  // Inicializacion de pesos y orden de los mini-lotes
+
+    // Arena de una muestra: la salida de la capa l empieza en act_off[l] y su delta en
+    // act_size + act_off[l]. Se dimensiona al construir la red.
+    vector<size_t> act_off;
+    size_t act_size;
+    BasicAlignedVector<Real> sample_arena;
+
+    // Arena de lotes: un bloque por hilo de entrenamiento con X, Y y, por capa, la
+    // salida y el delta de hasta batch_capacity filas. Solo crece.
+    int batch_capacity;
+    size_t batch_block;
+    BasicAlignedVector<Real> batch_arena;
+    vector<int> batch_order;
+
+    // Entrenamiento en paralelo (ver setTrainingThreads): direccion de descenso de cada
+    // hilo en un buffer plano de train_threads * param_count valores y error de cada hilo
+    int train_threads;
+    bool hogwild;
+    unique_ptr<ThreadPool> train_pool;
+    BasicAlignedVector<Real> worker_grads;
+    vector<double> worker_loss;
+
+    int stride(int layer_output) const { return paddedStride<Real>(sizes[layer_output]); }
+
+    // Los accesores no const solo se usan al entrenar (ver ownParams)
+    Real* w(int l) { return &params[off_w[l]]; }
+    Real* b(int l) { return &params[off_b[l]]; }
+    const Real* w(int l) const { return weights + off_w[l]; }
+    const Real* b(int l) const { return weights + off_b[l]; }
+
+    // Valida la arquitectura; lanza invalid_argument si no es valida
+    static void checkArchitecture(const vector<int>& layer_sizes, const vector<Activation>& layer_activations) {
+        if (layer_sizes.size() < 2 || layer_sizes.size() > (size_t)NN_MAX_LAYERS + 1) {
+            throw invalid_argument("la red necesita entre 1 y 64 capas");
+        }
+        if (layer_activations.size() != layer_sizes.size() - 1) {
+            throw invalid_argument("se necesita una activacion por capa");
+        }
+        for (size_t i = 0; i < layer_sizes.size(); i++) {
+            if (layer_sizes[i] <= 0 || layer_sizes[i] > NN_MAX_LAYER_SIZE) {
+                throw invalid_argument("tamano de capa invalido");
+            }
+        }
+        for (size_t l = 0; l + 1 < layer_activations.size(); l++) {
+            if (layer_activations[l] == ACT_SOFTMAX) {
+                throw invalid_argument("softmax solo puede usarse en la capa de salida");
+            }
+        }
+    }
+
+    // Distribucion del buffer de parametros y de la arena de una muestra; cada bloque
+    // empieza alineado
+    void computeLayout(const vector<int>& layer_sizes, const vector<Activation>& layer_activations) {
+        checkArchitecture(layer_sizes, layer_activations);
+        sizes = layer_sizes;
+        activations = layer_activations;
+        layer_count = (int)activations.size();
+
+        ld.resize(layer_count);
+        off_w.resize(layer_count);
+        off_b.resize(layer_count);
+        act_off.resize(layer_count);
+        param_count = 0;
+        act_size = 0;
+        for (int l = 0; l < layer_count; l++) {
+            ld[l] = stride(l);
+            off_w[l] = param_count;
+            off_b[l] = off_w[l] + (size_t)sizes[l + 1] * ld[l];
+            param_count = off_b[l] + stride(l + 1);
+            act_off[l] = act_size;
+            act_size += stride(l + 1);
+        }
+        sample_arena.assign(2 * act_size, Real(0));
+        batch_capacity = 0;
+        batch_block = 0;
+        train_threads = 1;
+        hogwild = false;
+        worker_loss.assign(1, 0.0);
+
+        optimizer = defaultOptimizer();
+        opt_steps = 0;
+        opt_epoch = 0;
+    }
+
+    // Aplica un paso del optimizador con la direccion de descenso acumulada g (suma
+    // sobre las muestras del lote) y la tasa lr. El estado se reserva en el primer paso.
+    void applyGradient(const Real* g, int samples, Real lr) {
+        size_t state = optimizerStateCount(optimizer.kind) * param_count;
+        if (opt_state.size() != state) opt_state.assign(state, Real(0));
+        opt_steps++;
+
+        int n = (int)param_count;
+        Real scale = Real(1) / samples;
+        switch (optimizer.kind) {
+            case OPT_MOMENTUM:
+            case OPT_NESTEROV:
+                momentumKernel(&params[0], &opt_state[0], g, n, lr, Real(optimizer.momentum), scale,
+                               optimizer.kind == OPT_NESTEROV);
+                break;
+            case OPT_ADAM: {
+                double correction = sqrt(1.0 - pow(optimizer.beta2, (double)opt_steps)) /
+                                    (1.0 - pow(optimizer.beta1, (double)opt_steps));
+                adamKernel(&params[0], &opt_state[0], &opt_state[param_count], g, n, Real(lr * correction),
+                           Real(optimizer.beta1), Real(optimizer.beta2), Real(optimizer.epsilon), scale);
+                break;
+            }
+            default:
+                axpyKernel(lr * scale, g, &params[0], n);
+                break;
+        }
+    }
+
+    // Antes de entrenar una red cargada de archivo: copia los parametros proyectados a
+    // memoria propia y libera la proyeccion
+    void ownParams() {
+        if (!params.empty()) return;
+        params.assign(weights, weights + param_count);
+        weights = &params[0];
+        model_file.close();
+    }
+
+    // Propagacion de una muestra sobre la arena acts (act_size valores, sin asignar
+    // memoria). Retorna la salida de la ultima capa, dentro de acts.
+    const Real* forwardInto(const Real* input, Real* acts) const {
+        const Real* x = input;
+        for (int l = 0; l < layer_count; l++) {
+            Real* y = acts + act_off[l];
+            gemvKernel(w(l), sizes[l + 1], sizes[l], ld[l], x, b(l), y);
+            activationKernel(y, 1, sizes[l + 1], stride(l + 1), activations[l], sigmoid_accuracy);
+            x = y;
+        }
+        return x;
+    }
+
+    // Bloques de la arena de lotes del hilo worker (batch_capacity filas cada uno)
+    Real* batchInputs(int worker) { return &batch_arena[worker * batch_block]; }
+    Real* batchTargets(int worker) { return batchInputs(worker) + (size_t)batch_capacity * stride(0); }
+    Real* batchOutput(int worker, int l) {
+        return batchTargets(worker) + (size_t)batch_capacity * (stride(layer_count) + 2 * act_off[l]);
+    }
+    Real* batchDelta(int worker, int l) {
+        return batchOutput(worker, l) + (size_t)batch_capacity * stride(l + 1);
+    }
+
+    // Direccion de descenso del hilo worker (param_count valores)
+    Real* workerGrad(int worker) { return &worker_grads[worker * param_count]; }
+
+    // Ajusta la arena de lotes a rows filas por hilo y los gradientes por hilo; solo
+    // asigna memoria si el lote o el numero de hilos crece
+    void reserveBatch(int rows) {
+        if (worker_grads.size() != train_threads * param_count) {
+            worker_grads.assign(train_threads * param_count, Real(0));
+        }
+        if (rows <= batch_capacity && batch_arena.size() == train_threads * batch_block) return;
+        batch_capacity = max(rows, batch_capacity);
+        batch_block = (size_t)batch_capacity * (stride(0) + stride(layer_count) + 2 * act_size);
+        batch_arena.assign(train_threads * batch_block, Real(0));
+    }
+
+    // Direccion de descenso de las filas rows[0..m) de (inputs, targets), sumada sobre
+    // las m muestras, en g; usa el bloque de arena del hilo worker. La propagacion y la
+    // retropropagacion del lote son productos matriz-matriz por capa. Retorna la suma
+    // del error de las muestras.
+    double batchGradient(int worker, const BasicMatrix<Real>& inputs, const BasicMatrix<Real>& targets,
+                         const int* rows, int m, Real* g) {
+        int out_size = outputSize();
+        int ld_in = stride(0), ld_out = stride(layer_count);
+        Real* x = batchInputs(worker);
+        Real* t = batchTargets(worker);
+        for (int r = 0; r < m; r++) {
+            const Real* in = inputs.row(rows[r]);
+            const Real* tg = targets.row(rows[r]);
+            copy(in, in + sizes[0], x + (size_t)r * ld_in);
+            copy(tg, tg + out_size, t + (size_t)r * ld_out);
+        }
+
+        // Propagacion: A_l = f_l(A_{l-1} W_l^T + b_l)
+        const Real* a_prev = x;
+        for (int l = 0; l < layer_count; l++) {
+            Real* a = batchOutput(worker, l);
+            gemmNTKernel(a_prev, stride(l), w(l), ld[l], b(l), a, stride(l + 1), m, sizes[l + 1], sizes[l]);
+            activationKernel(a, m, sizes[l + 1], stride(l + 1), activations[l], sigmoid_accuracy);
+            a_prev = a;
+        }
+
+        // Delta de salida
+        double loss = 0.0;
+        for (int r = 0; r < m; r++) {
+            size_t row = (size_t)r * ld_out;
+            outputDelta(a_prev + row, t + row, batchDelta(worker, layer_count - 1) + row, loss);
+        }
+
+        // Retropropagacion. Por capa: G_W = D^T A_{l-1}, G_b = suma de las filas de D, y
+        // el delta anterior (D W) .* f'(A_{l-1})
+        fill(g, g + param_count, Real(0));
+        for (int l = layer_count - 1; l >= 0; l--) {
+            const Real* d = batchDelta(worker, l);
+            const Real* a_in = (l > 0) ? batchOutput(worker, l - 1) : x;
+            int ld_d = stride(l + 1), ld_a = stride(l);
+            gemmTNKernel(Real(1), d, ld_d, a_in, ld_a, g + off_w[l], ld[l], sizes[l + 1], sizes[l], m);
+            for (int r = 0; r < m; r++) {
+                axpyKernel(Real(1), d + (size_t)r * ld_d, g + off_b[l], sizes[l + 1]);
+            }
+            if (l > 0) {
+                Real* d_prev = batchDelta(worker, l - 1);
+                gemmNNKernel(d, ld_d, w(l), ld[l], d_prev, ld_a, m, sizes[l], sizes[l + 1]);
+                for (int r = 0; r < m; r++) {
+                    activationDerivativeKernel(a_in + (size_t)r * ld_a, d_prev + (size_t)r * ld_a,
+                                               sizes[l], activations[l - 1]);
+                }
+            }
+        }
+        return loss;
+    }
+
+    // Gradiente de un lote repartido entre los hilos: cada hilo calcula el de su parte
+    // (el mismo reparto contiguo de ThreadPool) y la reduccion en arbol suma los de los
+    // hilos w y w + s en w, para s = 1, 2, 4..., con los parametros repartidos entre los
+    // hilos. El orden de las sumas es fijo, de modo que el resultado es reproducible.
+    // Deja la suma en workerGrad(0) y retorna la suma del error.
+    double parallelGradient(const BasicMatrix<Real>& inputs, const BasicMatrix<Real>& targets,
+                            const int* rows, int m) {
+        int threads = train_threads;
+        for (int w = 0; w < threads; w++) {
+            // Los hilos sin filas (lotes de menos muestras que hilos) no se ejecutan
+            if ((long long)m * w / threads == (long long)m * (w + 1) / threads) {
+                fill(workerGrad(w), workerGrad(w) + param_count, Real(0));
+                worker_loss[w] = 0.0;
+            }
+        }
+        train_pool->parallelFor(m, [&](int begin, int end, int w) {
+            worker_loss[w] = batchGradient(w, inputs, targets, rows + begin, end - begin, workerGrad(w));
+        });
+        train_pool->parallelFor((int)param_count, [&](int begin, int end, int) {
+            for (int s = 1; s < threads; s *= 2) {
+                for (int w = 0; w + s < threads; w += 2 * s) {
+                    axpyKernel(Real(1), (const Real*)workerGrad(w + s) + begin, workerGrad(w) + begin, end - begin);
+                }
+            }
+        });
+
+        double loss = 0.0;
+        for (int w = 0; w < threads; w++) loss += worker_loss[w];
+        return loss;
+    }
+
+    // Una epoca Hogwild: cada hilo recorre su parte de las muestras barajadas en lotes
+    // de batch_size y aplica cada paso de SGD directamente sobre los pesos compartidos,
+    // sin sincronizacion. Las lecturas y escrituras concurrentes de los pesos son
+    // carreras deliberadas: el algoritmo tolera actualizaciones perdidas o mezcladas, a
+    // cambio de no esperar la reduccion. Usa SGD con la tasa del programa en lugar del
+    // optimizador configurado (su estado no admite escrituras concurrentes) y el
+    // resultado no es reproducible. Retorna la suma del error de la epoca.
+    double hogwildEpoch(const BasicMatrix<Real>& inputs, const BasicMatrix<Real>& targets, int batch_size,
+                        Real lr) {
+        fill(worker_loss.begin(), worker_loss.end(), 0.0);
+        train_pool->parallelFor(inputs.rows, [&](int begin, int end, int w) {
+            double loss = 0.0;
+            for (int start = begin; start < end; start += batch_size) {
+                int m = min(batch_size, end - start);
+                loss += batchGradient(w, inputs, targets, &batch_order[start], m, workerGrad(w));
+                axpyKernel(lr / m, (const Real*)workerGrad(w), &params[0], (int)param_count);
+            }
+            worker_loss[w] = loss;
+        });
+
+        double loss = 0.0;
+        for (size_t w = 0; w < worker_loss.size(); w++) loss += worker_loss[w];
+        return loss;
+    }
+
+    // Delta de la capa de salida a partir de su salida y el objetivo; acumula el error
+    // (cuadratico, o entropia cruzada con softmax) en loss
+    void outputDelta(const Real* y, const Real* target, Real* delta, double& loss) const {
+        int n = sizes[layer_count];
+        if (activations[layer_count - 1] == ACT_SOFTMAX) {
+            for (int j = 0; j < n; j++) {
+                delta[j] = target[j] - y[j];
+                if (target[j] > Real(0)) loss -= target[j] * log(max((double)y[j], 1e-12));
+            }
+        } else {
+            for (int j = 0; j < n; j++) {
+                Real err = target[j] - y[j];
+                loss += err * err;
+                delta[j] = err;
+            }
+            activationDerivativeKernel(y, delta, n, activations[layer_count - 1]);
+        }
+    }
+
+    // Inicializa pesos y bias con valores aleatorios en [-1, 1]: primero los pesos de
+    // todas las capas (por entrada y luego por neurona) y despues los bias
+    void randomize() {
+        uniform_real_distribution<> dis(-1.0, 1.0);
+        for (int l = 0; l < layer_count; l++) {
+            for (int i = 0; i < sizes[l]; i++) {
+                for (int j = 0; j < sizes[l + 1]; j++) {
+                    w(l)[(size_t)j * ld[l] + i] = dis(rng);
+                }
+            }
+        }
+        for (int l = 0; l < layer_count; l++) {
+            for (int j = 0; j < sizes[l + 1]; j++) {
+                b(l)[j] = dis(rng);
+            }
+        }
+    }
+
+public:
+    // Red de una capa oculta con sigmoide (entrada -> oculta -> salida)
+    BasicNeuralNetwork(int input, int hidden, int output, double lr = 0.1, uint32_t seed = randomSeed())
+        : BasicNeuralNetwork(vector<int>{input, hidden, output}, vector<Activation>(2, ACT_SIGMOID), lr, seed) {}
+
+    // Red de cualquier profundidad: layer_sizes tiene la entrada y la salida de cada
+    // capa, y layer_activations una activacion por capa (softmax solo en la ultima).
+    // La semilla fija los pesos iniciales y el orden de los mini-lotes: con la misma
+    // semilla (y el mismo numero de hilos) el entrenamiento se repite exactamente.
+    // Lanza invalid_argument si la arquitectura no es valida.
+    BasicNeuralNetwork(const vector<int>& layer_sizes, const vector<Activation>& layer_activations,
+                       double lr = 0.1, uint32_t seed = randomSeed()) {
+        computeLayout(layer_sizes, layer_activations);
+        learning_rate = Real(lr);
+        sigmoid_accuracy = SIGMOID_FAST;
+
+        params.assign(param_count, Real(0));
+        weights = &params[0];
+
+        rng.seed(seed);
+        randomize();
+    }
+
+    // Copia de una red con otro tipo escalar (por ejemplo, una red double entrenada
+    // convertida a float para inferencia)
+    template <class Other>
+    explicit BasicNeuralNetwork(const BasicNeuralNetwork<Other>& other) {
+        computeLayout(other.sizes, other.activations);
+        learning_rate = Real(other.learning_rate);
+        sigmoid_accuracy = other.sigmoid_accuracy;
+        optimizer = other.optimizer;
+
+        params.assign(param_count, Real(0));
+        weights = &params[0];
+
+        for (int l = 0; l < layer_count; l++) {
+            for (int j = 0; j < sizes[l + 1]; j++) {
+                const Other* src = other.w(l) + (size_t)j * other.ld[l];
+                copy(src, src + sizes[l], w(l) + (size_t)j * ld[l]);
+            }
+            copy(other.b(l), other.b(l) + sizes[l + 1], b(l));
+        }
+
+        rng.seed(randomSeed());
+    }
+
+    // Carga un modelo guardado con save() proyectando el archivo en memoria: los
+    // parametros se usan en su lugar, sin leerlos ni convertirlos. Lanza runtime_error
+    // si el archivo no existe, no es un modelo valido o su checksum no coincide.
+    explicit BasicNeuralNetwork(const string& modelPath) {
+        if (!model_file.open(modelPath)) {
+            throw runtime_error("no se pudo abrir " + modelPath);
+        }
+        if (model_file.size() < sizeof(ModelFileHeader)) {
+            throw runtime_error(modelPath + " no es un modelo (archivo demasiado corto)");
+        }
+
+        ModelFileHeader header;
+        memcpy(&header, model_file.data(), sizeof(header));
+        if (memcmp(header.magic, NN_MODEL_MAGIC, sizeof(header.magic)) != 0) {
+            throw runtime_error(modelPath + " no es un modelo de la red neuronal");
+        }
+        if (header.version != NN_MODEL_VERSION || header.header_size != sizeof(ModelFileHeader)) {
+            throw runtime_error(modelPath + " tiene una version de formato no soportada");
+        }
+        if (header.scalar_size != (int32_t)sizeof(Real)) {
+            throw runtime_error(modelPath + " fue guardado con otro tipo escalar");
+        }
+        if (header.layer_count <= 0 || header.layer_count > NN_MAX_LAYERS ||
+            model_file.size() < sizeof(header) + header.layer_count * sizeof(ModelLayerRecord)) {
+            throw runtime_error(modelPath + " tiene una tabla de capas invalida");
+        }
+
+        // La tabla de capas sigue a la cabecera
+        const ModelLayerRecord* table = (const ModelLayerRecord*)(model_file.data() + sizeof(header));
+        vector<int> layer_sizes(1, header.input_size);
+        vector<Activation> layer_activations;
+        for (int l = 0; l < header.layer_count; l++) {
+            if (table[l].activation < ACT_SIGMOID || table[l].activation > ACT_SOFTMAX) {
+                throw runtime_error(modelPath + " tiene una activacion desconocida");
+            }
+            layer_sizes.push_back(table[l].size);
+            layer_activations.push_back((Activation)table[l].activation);
+        }
+        try {
+            computeLayout(layer_sizes, layer_activations);
+        } catch (const invalid_argument& e) {
+            throw runtime_error(modelPath + " tiene una arquitectura invalida: " + e.what());
+        }
+        learning_rate = Real(header.learning_rate);
+        sigmoid_accuracy = SIGMOID_FAST;
+
+        if (header.param_count != param_count || header.param_offset % NN_ALIGNMENT != 0 ||
+            header.param_offset < sizeof(header) + header.layer_count * sizeof(ModelLayerRecord) ||
+            model_file.size() < header.param_offset + param_count * sizeof(Real)) {
+            throw runtime_error(modelPath + " esta truncado o tiene una distribucion invalida");
+        }
+        weights = (const Real*)(model_file.data() + header.param_offset);
+        if (modelChecksum(header, table, weights, param_count * sizeof(Real)) != header.checksum) {
+            throw runtime_error(modelPath + " esta danado (checksum incorrecto)");
+        }
+
+        rng.seed(randomSeed());
+    }
+
+    // Guarda el modelo en el formato binario de ModelFileHeader. Retorna false si no
+    // se pudo escribir el archivo.
+    bool save(const string& path) const {
+        vector<ModelLayerRecord> table(layer_count);
+        for (int l = 0; l < layer_count; l++) {
+            table[l].size = sizes[l + 1];
+            table[l].activation = activations[l];
+        }
+
+        ModelFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, NN_MODEL_MAGIC, sizeof(header.magic));
+        header.version = NN_MODEL_VERSION;
+        header.header_size = sizeof(ModelFileHeader);
+        header.input_size = sizes[0];
+        header.layer_count = layer_count;
+        header.scalar_size = sizeof(Real);
+        header.learning_rate = learning_rate;
+        size_t table_end = sizeof(header) + table.size() * sizeof(ModelLayerRecord);
+        header.param_offset = (table_end + NN_ALIGNMENT - 1) / NN_ALIGNMENT * NN_ALIGNMENT;
+        header.param_count = param_count;
+        header.checksum = modelChecksum(header, &table[0], weights, param_count * sizeof(Real));
+
+        ofstream out(path.c_str(), ios::binary | ios::trunc);
+        if (!out.is_open()) return false;
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)&table[0], table.size() * sizeof(ModelLayerRecord));
+        for (size_t i = table_end; i < header.param_offset; i++) out.put('\0');
+        out.write((const char*)weights, param_count * sizeof(Real));
+        return (bool)out;
+    }
+
+    int inputSize() const { return sizes[0]; }
+    int outputSize() const { return sizes[layer_count]; }
+    int layerCount() const { return layer_count; }
+    int layerSize(int l) const { return sizes[l + 1]; }
+    Activation layerActivation(int l) const { return activations[l]; }
+    const vector<int>& layerSizes() const { return sizes; }
+    const vector<Activation>& layerActivations() const { return activations; }
+
+    // Optimizador de train y trainBatch (SGD con tasa constante por defecto). Cambiarlo
+    // reinicia su estado y el programa de la tasa.
+    const OptimizerConfig& optimizerConfig() const { return optimizer; }
+    void setOptimizer(const OptimizerConfig& config) {
+        optimizer = config;
+        opt_state.clear();
+        opt_steps = 0;
+        opt_epoch = 0;
+    }
+
+    double learningRate() const { return learning_rate; }
+    void setLearningRate(double lr) { learning_rate = Real(lr); }
+
+    // Tasa de la proxima epoca segun el programa del optimizador
+    double currentLearningRate() const { return scheduledLearningRate(optimizer, learning_rate, opt_epoch); }
+
+    // Valores del buffer que necesita predictInto(entrada, salida, scratch)
+    size_t scratchSize() const { return act_size; }
+
+    // Precision de la sigmoide (y de tanh y softmax) en propagacion y entrenamiento
+    // (SIGMOID_FAST por defecto)
+    SigmoidAccuracy sigmoidAccuracy() const { return sigmoid_accuracy; }
+    void setSigmoidAccuracy(SigmoidAccuracy accuracy) { sigmoid_accuracy = accuracy; }
+
+    // Propagación hacia adelante; activations_out recibe la salida de cada capa oculta
+    // una tras otra
+    vector<Real> forward(const vector<Real>& input, vector<Real>& activations_out) {
+        const Real* y = forwardInto(&input[0], &sample_arena[0]);
+        activations_out.clear();
+        for (int l = 0; l + 1 < layer_count; l++) {
+            const Real* h = &sample_arena[act_off[l]];
+            activations_out.insert(activations_out.end(), h, h + sizes[l + 1]);
+        }
+        return vector<Real>(y, y + outputSize());
+    }
+
+    // Entrenamiento con backpropagation sobre una muestra (usa la arena de la red);
+    // cada epoca es un paso del optimizador
+    void train(const vector<Real>& input, const vector<Real>& target, int epochs) {
+        ownParams();
+        reserveBatch(0);
+        Real* grads = workerGrad(0);
+        Real* acts = &sample_arena[0];
+        Real* deltas = acts + act_size;
+        double loss = 0.0;
+
+        for (int epoch = 0; epoch < epochs; epoch++) {
+            const Real* y = forwardInto(&input[0], acts);
+            outputDelta(y, &target[0], deltas + act_off[layer_count - 1], loss);
+            fill(grads, grads + param_count, Real(0));
+
+            for (int l = layer_count - 1; l >= 0; l--) {
+                Real* d = deltas + act_off[l];
+                const Real* x = (l > 0) ? acts + act_off[l - 1] : &input[0];
+
+                // Delta de la capa anterior: W^T * delta, por la derivada de su activacion
+                if (l > 0) {
+                    Real* d_prev = deltas + act_off[l - 1];
+                    gemvTransposedKernel(w(l), sizes[l + 1], sizes[l], ld[l], (const Real*)d, d_prev);
+                    activationDerivativeKernel(x, d_prev, sizes[l], activations[l - 1]);
+                }
+
+                // Direccion de descenso de pesos y bias de la capa
+                gerKernel(grads + off_w[l], sizes[l + 1], sizes[l], ld[l], Real(1), (const Real*)d, x);
+                axpyKernel(Real(1), (const Real*)d, grads + off_b[l], sizes[l + 1]);
+            }
+
+            applyGradient(grads, 1, Real(currentLearningRate()));
+            opt_epoch++;
+        }
+    }
+
+    // Entrenamiento por mini-lotes: cada epoca baraja las filas de (inputs, targets) y
+    // aplica el optimizador con el gradiente medio de cada lote, con la tasa que el
+    // programa fija para la epoca. Con varios hilos (setTrainingThreads) cada lote se
+    // reparte entre ellos. Retorna el error medio de la ultima epoca: cuadratico por
+    // salida o, con softmax, entropia cruzada por muestra. No asigna memoria una vez
+    // que la arena alcanza el tamano del lote.
+    double trainBatch(const BasicMatrix<Real>& inputs, const BasicMatrix<Real>& targets, int epochs,
+                      int batch_size) {
+        ownParams();
+        int samples = inputs.rows;
+        batch_size = max(1, min(batch_size, samples));
+        int threads = train_threads;
+        // Cada hilo procesa su parte de cada lote o, en modo Hogwild, lotes completos
+        reserveBatch((threads == 1 || hogwild) ? batch_size : (batch_size + threads - 1) / threads);
+
+        batch_order.resize(samples);
+        for (int i = 0; i < samples; i++) batch_order[i] = i;
+
+        double epoch_loss = 0.0;
+        for (int epoch = 0; epoch < epochs; epoch++) {
+            shuffle(batch_order.begin(), batch_order.end(), rng);
+            epoch_loss = 0.0;
+            Real lr = Real(currentLearningRate());
+
+            if (hogwild) {
+                epoch_loss = hogwildEpoch(inputs, targets, batch_size, lr);
+            } else {
+                for (int start = 0; start < samples; start += batch_size) {
+                    int m = min(batch_size, samples - start);
+                    if (threads == 1) {
+                        epoch_loss += batchGradient(0, inputs, targets, &batch_order[start], m, workerGrad(0));
+                    } else {
+                        epoch_loss += parallelGradient(inputs, targets, &batch_order[start], m);
+                    }
+                    applyGradient(workerGrad(0), m, lr);
+                }
+            }
+            opt_epoch++;
+            if (activations[layer_count - 1] == ACT_SOFTMAX) epoch_loss /= (double)samples;
+            else epoch_loss /= (double)samples * outputSize();
+        }
+        return epoch_loss;
+    }
+
+    // Hilos de trainBatch (1 por defecto, sin hilos adicionales). Con varios hilos cada
+    // lote se reparte en partes contiguas, una por hilo, y sus gradientes se suman con
+    // una reduccion en arbol de orden fijo: el resultado depende solo de la semilla y
+    // del numero de hilos. Con lock_free se usa Hogwild (ver hogwildEpoch).
+    void setTrainingThreads(int threads, bool lock_free = false) {
+        threads = max(1, threads);
+        hogwild = lock_free && threads > 1;
+        if (threads == train_threads) return;
+        train_threads = threads;
+        train_pool.reset(threads > 1 ? new ThreadPool(threads) : nullptr);
+        worker_loss.assign(threads, 0.0);
+    }
+    int trainingThreads() const { return train_threads; }
+    bool hogwildTraining() const { return hogwild; }
+
+    // Semilla del orden de los mini-lotes desde este punto
+    void setSeed(uint32_t seed) { rng.seed(seed); }
+
+    // Error medio sobre (inputs, targets), como el de trainBatch, y porcentaje de
+    // muestras acertadas: todas las salidas del lado correcto de 0.5 o, con softmax,
+    // la salida mayor en la clase objetivo. Usa la arena de la red.
+    void evaluate(const BasicMatrix<Real>& inputs, const BasicMatrix<Real>& targets, double& loss,
+                  double& accuracy) {
+        Real* acts = &sample_arena[0];
+        Real* deltas = acts + act_size;
+        int n = outputSize();
+        bool softmax = (activations[layer_count - 1] == ACT_SOFTMAX);
+        double sum = 0.0;
+        int correct = 0;
+        for (int i = 0; i < inputs.rows; i++) {
+            const Real* y = forwardInto(inputs.row(i), acts);
+            const Real* t = targets.row(i);
+            outputDelta(y, t, deltas, sum);
+            bool ok = true;
+            if (softmax) {
+                ok = (t[max_element(y, y + n) - y] > Real(0.5));
+            } else {
+                for (int j = 0; j < n; j++) ok = ok && ((y[j] > Real(0.5)) == (t[j] > Real(0.5)));
+            }
+            correct += ok;
+        }
+        loss = softmax ? sum / max(1, inputs.rows) : sum / max(1, inputs.rows * n);
+        accuracy = 100.0 * correct / max(1, inputs.rows);
+    }
+
+    // Predecir
+    vector<Real> predict(const vector<Real>& input) {
+        vector<Real> output(outputSize());
+        predictInto(&input[0], &output[0]);
+        return output;
+    }
+
+    // Prediccion sin asignar memoria: input tiene inputSize() valores y output recibe
+    // outputSize() valores. Usa la arena de la red (no es reentrante).
+    void predictInto(const Real* input, Real* output) {
+        const Real* y = forwardInto(input, &sample_arena[0]);
+        copy(y, y + outputSize(), output);
+    }
+
+    // Variante de solo lectura para varios hilos sobre los mismos pesos: cada hilo
+    // aporta su propio buffer scratch de scratchSize() valores
+    void predictInto(const Real* input, Real* output, Real* scratch) const {
+        const Real* y = forwardInto(input, scratch);
+        copy(y, y + outputSize(), output);
+    }
+
+    // Bytes ocupados por los parametros (con el relleno de alineacion)
+    size_t parameterBytes() const { return param_count * sizeof(Real); }
+};
+
+typedef BasicNeuralNetwork<double> NeuralNetwork;
+
+// Producto punto int8 con acumulacion en int32 (el compilador lo vectoriza con
+// multiplicaciones-suma de enteros de 16 bits)
+inline int32_t dotInt8Kernel(const int8_t* a, const int8_t* b, int n) {
+    int32_t acc = 0;
+    for (int i = 0; i < n; i++) acc += (int32_t)a[i] * (int32_t)b[i];
+    return acc;
+}
+
+// Inferencia cuantizada a int8 despues del entrenamiento. Los pesos de cada capa se
+// guardan en int8 con una escala por capa (max|W| / 127). La entrada de cada capa usa
+// tambien una escala fija cuando su rango es conocido: input_range / 127 para la
+// entrada de la red (se satura fuera de [-input_range, input_range]) y 1 / 127 tras
+// sigmoide, tanh o softmax. Tras ReLU, sin cota, la escala se calcula por muestra
+// (max|x| / 127). Los productos int8 x int8 se acumulan en int32 y se reescalan a
+// float para sumar el bias y aplicar la activacion.
+class QuantizedNetwork {
+private:
+    int layer_count;
+    vector<int> sizes;
+    vector<Activation> activations;
+
+    // Por capa: stride de W en int8, desplazamientos en w_q y b_f, y escalas de los
+    // pesos y de la entrada (0 = calculada por muestra)
+    vector<int> ld;
+    vector<size_t> off_w, off_b;
+    vector<float> scale_w, scale_x;
+
+    BasicAlignedVector<int8_t> w_q;
+    BasicAlignedVector<float> b_f;
+
+    // Espacios de trabajo de una muestra: entrada cuantizada y salida de la capa
+    BasicAlignedVector<int8_t> input_q;
+    BasicAlignedVector<float> act_ws;
+
+    // Cuantiza una capa (rows x cols, stride ld_src) en out (stride ld_out); retorna
+    // la escala de la capa
+    template <class Real>
+    static float quantizeLayer(const Real* W, int rows, int cols, int ld_src, int8_t* out, int ld_out) {
+        float max_abs = 0.0f;
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) max_abs = max(max_abs, (float)fabs(W[(size_t)r * ld_src + c]));
+        }
+        float scale = (max_abs > 0.0f) ? max_abs / 127.0f : 1.0f;
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < cols; c++) {
+                out[(size_t)r * ld_out + c] = (int8_t)lrintf((float)W[(size_t)r * ld_src + c] / scale);
+            }
+        }
+        return scale;
+    }
+
+    // Cuantiza n activaciones en out con la escala dada, saturando a [-127, 127]
+    template <class T>
+    static void quantizeVector(const T* x, int n, float scale, int8_t* out) {
+        float inv = 1.0f / scale;
+        for (int i = 0; i < n; i++) {
+            float q = min(127.0f, max(-127.0f, (float)x[i] * inv));
+            out[i] = (int8_t)(q + (q >= 0.0f ? 0.5f : -0.5f));  // Redondeo vectorizable
+        }
+    }
+
+    // Escala por muestra para entradas sin cota conocida
+    static float dynamicScale(const float* x, int n) {
+        float max_abs = 0.0f;
+        for (int i = 0; i < n; i++) max_abs = max(max_abs, fabs(x[i]));
+        return (max_abs > 0.0f) ? max_abs / 127.0f : 1.0f;
+    }
+
+public:
+    template <class Real>
+    explicit QuantizedNetwork(const BasicNeuralNetwork<Real>& nn, float input_range = 1.0f) {
+        layer_count = nn.layer_count;
+        sizes = nn.sizes;
+        activations = nn.activations;
+
+        ld.resize(layer_count);
+        off_w.resize(layer_count);
+        off_b.resize(layer_count);
+        scale_w.resize(layer_count);
+        scale_x.resize(layer_count);
+        size_t w_count = 0, b_count = 0;
+        int max_size = 0;
+        for (int l = 0; l < layer_count; l++) {
+            ld[l] = paddedStride<int8_t>(sizes[l]);
+            off_w[l] = w_count;
+            off_b[l] = b_count;
+            w_count += (size_t)sizes[l + 1] * ld[l];
+            b_count += paddedStride<float>(sizes[l + 1]);
+            max_size = max(max_size, max(sizes[l], sizes[l + 1]));
+        }
+
+        w_q.assign(w_count, 0);
+        b_f.assign(b_count, 0.0f);
+        for (int l = 0; l < layer_count; l++) {
+            scale_w[l] = quantizeLayer(nn.w(l), sizes[l + 1], sizes[l], nn.ld[l], &w_q[off_w[l]], ld[l]);
+            copy(nn.b(l), nn.b(l) + sizes[l + 1], &b_f[off_b[l]]);
+            if (l == 0) scale_x[l] = input_range / 127.0f;
+            else scale_x[l] = (activations[l - 1] == ACT_RELU) ? 0.0f : 1.0f / 127.0f;
+        }
+
+        input_q.assign(paddedStride<int8_t>(max_size), 0);
+        act_ws.assign(2 * (size_t)paddedStride<float>(max_size), 0.0f);
+    }
+
+    int inputSize() const { return sizes[0]; }
+    int outputSize() const { return sizes[layer_count]; }
+
+    // Prediccion sin asignar memoria (usa el espacio de trabajo; no es reentrante).
+    // Las salidas de capas consecutivas alternan entre las dos mitades de act_ws.
+    template <class T>
+    void predictInto(const T* input, T* output) {
+        size_t half = act_ws.size() / 2;
+        const float* x = nullptr;
+        for (int l = 0; l < layer_count; l++) {
+            float sx = scale_x[l];
+            if (l == 0) {
+                quantizeVector(input, sizes[0], sx, &input_q[0]);
+            } else {
+                if (sx == 0.0f) sx = dynamicScale(x, sizes[l]);
+                quantizeVector(x, sizes[l], sx, &input_q[0]);
+            }
+
+            float* y = &act_ws[(l % 2) * half];
+            float scale = scale_w[l] * sx;
+            const int8_t* W = &w_q[off_w[l]];
+            const float* bias = &b_f[off_b[l]];
+            for (int j = 0; j < sizes[l + 1]; j++) {
+                int32_t acc = dotInt8Kernel(W + (size_t)j * ld[l], &input_q[0], sizes[l]);
+                y[j] = bias[j] + scale * (float)acc;
+            }
+            activationKernel(y, 1, sizes[l + 1], sizes[l + 1], activations[l], SIGMOID_FAST);
+            x = y;
+        }
+        for (int j = 0; j < outputSize(); j++) output[j] = (T)x[j];
+    }
+
+    // Bytes ocupados por los parametros (con el relleno de alineacion)
+    size_t parameterBytes() const { return w_q.size() + b_f.size() * sizeof(float); }
+};
+
+// Dimensiones de los mapas de bits de digitos.txt: 7 filas de 5 pixeles por digito
+const int BITMAP_ROWS = 7;
+const int BITMAP_COLS = 5;
+const int BITMAP_PIXELS = BITMAP_ROWS * BITMAP_COLS;
+
+// Mapas de bits de referencia de los digitos 0-9 (los mismos del digitos.txt de ejemplo)
+const char* const DIGIT_GLYPHS[10][BITMAP_ROWS] = {
+    {"01110", "10001", "10011", "10101", "11001", "10001", "01110"},
+    {"00100", "01100", "00100", "00100", "00100", "00100", "01110"},
+    {"01110", "10001", "00001", "00010", "00100", "01000", "11111"},
+    {"01110", "10001", "00001", "00110", "00001", "10001", "01110"},
+    {"00010", "00110", "01010", "10010", "11111", "00010", "00010"},
+    {"11111", "10000", "11110", "00001", "00001", "10001", "01110"},
+    {"00110", "01000", "10000", "11110", "10001", "10001", "01110"},
+    {"11111", "00001", "00010", "00100", "01000", "01000", "01000"},
+    {"01110", "10001", "10001", "01110", "10001", "10001", "01110"},
+    {"01110", "10001", "10001", "01111", "00001", "00010", "01100"}
+};
+
+// Función para convertir un dígito a vector de entrada (su mapa de bits de referencia)
+void digitToInput(int digit, double* input) {
+    for (int r = 0; r < BITMAP_ROWS; r++) {
+        for (int c = 0; c < BITMAP_COLS; c++) {
+            input[r * BITMAP_COLS + c] = (DIGIT_GLYPHS[digit][r][c] == '1') ? 1.0 : 0.0;
+        }
+    }
+}
+
+// Dígito cuyo mapa de bits de referencia coincide exactamente con pixels, o -1
+int matchDigit(const double* pixels) {
+    double glyph[BITMAP_PIXELS];
+    for (int d = 0; d < 10; d++) {
+        digitToInput(d, glyph);
+        if (equal(glyph, glyph + BITMAP_PIXELS, pixels)) return d;
+    }
+    return -1;
+}
+
+// Función para determinar las clases de un número
+vector<double> getClasses(int number) {
+    vector<double> classes(4, 0.0);
+    
+    // Clase 0: Números pares (0, 2, 4, 6, 8)
+    if (number % 2 == 0) {
+        classes[0] = 1.0;
+    }
+    
+    // Clase 1: Números impares (1, 3, 5, 7, 9)
+    if (number % 2 != 0) {
+        classes[1] = 1.0;
+    }
+    
+    // Clase 2: Números primos (2, 3, 5, 7)
+    if (number == 2 || number == 3 || number == 5 || number == 7) {
+        classes[2] = 1.0;
+    }
+    
+    // Clase 3: Números compuestos (4, 6, 8, 9)
+    if (number == 4 || number == 6 || number == 8 || number == 9) {
+        classes[3] = 1.0;
+    }
+    
+    return classes;
+}
+
+// Función para obtener el nombre de la clase
+string getClassName(int classIndex) {
+    switch(classIndex) {
+        case 0: return "Numeros pares";
+        case 1: return "Numeros impares";
+        case 2: return "Numeros primos";
+        case 3: return "Numeros compuestos";
+        default: return "Desconocido";
+    }
+}
+
+// Función para mostrar barra de progreso
+void mostrarProgreso(int actual, int total, string mensaje) {
+    int barWidth = 50;
+    float progreso = (float)actual / total;
+    int pos = barWidth * progreso;
+    
+    cout << "\r" << mensaje << " [";
+    for (int i = 0; i < barWidth; ++i) {
+        if (i < pos) cout << "=";
+        else if (i == pos) cout << ">";
+        else cout << " ";
+    }
+    cout << "] " << int(progreso * 100.0) << "% (" << actual << "/" << total << ")";
+    cout.flush();
+}
+
+// Conjunto de entrenamiento: los 10 digitos a la vez, para no olvidar los anteriores
+void buildTrainingSet(Matrix& inputs, Matrix& targets) {
+    inputs = Matrix(10, BITMAP_PIXELS);
+    targets = Matrix(10, 4);
+    for (int i = 0; i < 10; i++) {
+        digitToInput(i, inputs.row(i));
+        vector<double> target = getClasses(i);
+        copy(target.begin(), target.end(), targets.row(i));
+    }
+}
+
+// Conjunto de prueba: digitos de referencia (0-9 en ciclo) con entre minFlips y maxFlips
+// pixeles invertidos al azar en cada muestra
+void buildNoisySet(int samples, int maxFlips, unsigned seed, Matrix& inputs, Matrix& targets,
+                   int minFlips = 0) {
+    inputs = Matrix(samples, BITMAP_PIXELS);
+    targets = Matrix(samples, 4);
+    mt19937 gen(seed);
+    uniform_int_distribution<int> flips(minFlips, maxFlips);
+    uniform_int_distribution<int> pixel(0, BITMAP_PIXELS - 1);
+    for (int i = 0; i < samples; i++) {
+        int digit = i % 10;
+        double* in = inputs.row(i);
+        digitToInput(digit, in);
+        for (int f = flips(gen); f > 0; f--) {
+            int p = pixel(gen);
+            in[p] = 1.0 - in[p];
+        }
+        vector<double> target = getClasses(digit);
+        copy(target.begin(), target.end(), targets.row(i));
+    }
+}
+
+// Modelo entrenado que se reutiliza entre ejecuciones
+const char* const MODEL_FILENAME = "modelo_rna.bin";
+
+// Arquitectura de la red del programa: la entrada es siempre un mapa de bits y la
+// ultima capa tiene una neurona por clase
+struct NetworkSpec {
+    vector<int> sizes;               // sizes[0] = BITMAP_PIXELS
+    vector<Activation> activations;  // Una por capa
+};
+
+// Arquitectura por defecto: una capa oculta de 8 neuronas con sigmoide
+NetworkSpec defaultArchitecture() {
+    NetworkSpec spec;
+    spec.sizes.push_back(BITMAP_PIXELS);
+    spec.sizes.push_back(8);
+    spec.sizes.push_back(4);
+    spec.activations.assign(2, ACT_SIGMOID);
+    return spec;
+}
+
+// Interpreta la opcion --capas: "neuronas:activacion" por capa separadas por comas,
+// por ejemplo "16:relu,8:tanh,4:sigmoid". La ultima capa debe tener 4 neuronas y no
+// puede usar softmax, porque las 4 clases no son excluyentes (cada digito pertenece
+// a dos). Retorna false con el motivo en reason si la especificacion no es valida.
+bool parseArchitecture(const string& text, NetworkSpec& spec, string& reason) {
+    NetworkSpec parsed;
+    parsed.sizes.push_back(BITMAP_PIXELS);
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t comma = text.find(',', pos);
+        if (comma == string::npos) comma = text.size();
+        string layer = text.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        size_t colon = layer.find(':');
+        string name = (colon == string::npos) ? "sigmoid" : layer.substr(colon + 1);
+        char* end = nullptr;
+        long size = strtol(layer.c_str(), &end, 10);
+        if (end == layer.c_str() || (colon == string::npos ? *end != '\0' : end != layer.c_str() + colon) ||
+            size <= 0 || size > NN_MAX_LAYER_SIZE) {
+            reason = "tamano de capa invalido en \"" + layer + "\"";
+            return false;
+        }
+
+        Activation activation;
+        if (name == "sigmoid") activation = ACT_SIGMOID;
+        else if (name == "relu") activation = ACT_RELU;
+        else if (name == "tanh") activation = ACT_TANH;
+        else if (name == "softmax") activation = ACT_SOFTMAX;
+        else {
+            reason = "activacion desconocida \"" + name + "\" (sigmoid, relu, tanh o softmax)";
+            return false;
+        }
+        parsed.sizes.push_back((int)size);
+        parsed.activations.push_back(activation);
+    }
+
+    if (parsed.activations.size() > (size_t)NN_MAX_LAYERS) {
+        reason = "la red admite hasta 64 capas";
+        return false;
+    }
+    if (parsed.sizes.back() != 4) {
+        reason = "la capa de salida debe tener 4 neuronas (una por clase)";
+        return false;
+    }
+    for (size_t l = 0; l < parsed.activations.size(); l++) {
+        if (parsed.activations[l] == ACT_SOFTMAX) {
+            reason = "softmax no se admite: las clases no son excluyentes";
+            return false;
+        }
+    }
+    spec = parsed;
+    return true;
+}
+
+// Descripcion de una arquitectura, en el formato de --capas
+string describeArchitecture(const NetworkSpec& spec) {
+    string text;
+    for (size_t l = 0; l < spec.activations.size(); l++) {
+        if (l > 0) text += ",";
+        text += to_string(spec.sizes[l + 1]) + ":" + activationName(spec.activations[l]);
+    }
+    return text;
+}
+
+// Plan de entrenamiento del programa: optimizador, tasa base, epocas maximas, tamano
+// de lote, hilos de entrenamiento, semilla y parada temprana. Cada eval_interval
+// epocas se evalua la red sobre el conjunto de validacion; el entrenamiento se detiene
+// al alcanzar target_accuracy o cuando el error de validacion no mejora al menos
+// min_improvement (relativo) en patience evaluaciones seguidas.
+struct TrainingPlan {
+    OptimizerConfig optimizer;
+    double learning_rate;
+    int epochs;
+    int batch_size;
+    int threads;
+    bool hogwild;
+    uint32_t seed;
+    int eval_interval;       // 0 = sin validacion (siempre epochs epocas)
+    int patience;
+    double min_improvement;
+    double target_accuracy;  // Porcentaje
+    bool retrain;            // Plan pedido explicitamente: no se reutiliza el modelo guardado
+};
+
+// Resultado de trainNetwork
+struct TrainingResult {
+    int epochs;
+    double loss;            // Error de entrenamiento de la ultima epoca
+    double val_loss;        // Error y exactitud de la ultima evaluacion (0 sin validacion)
+    double val_accuracy;
+    const char* stop;       // Motivo del fin del entrenamiento
+};
+
+// Plan por defecto de cada optimizador. SGD conserva la tasa 0.5 constante y las 1000
+// epocas originales; los demas bajan la tasa con medio coseno y llegan al mismo error
+// en muchas menos epocas (Adam, el plan del programa, en unas 150).
+TrainingPlan defaultTrainingPlan(OptimizerKind kind = OPT_ADAM) {
+    TrainingPlan plan;
+    plan.optimizer = defaultOptimizer(kind);
+    plan.batch_size = 5;
+    plan.threads = 1;
+    plan.hogwild = false;
+    plan.seed = randomSeed();
+    plan.eval_interval = 10;
+    plan.patience = 3;
+    plan.min_improvement = 0.01;
+    plan.target_accuracy = 99.0;
+    plan.retrain = false;
+    switch (kind) {
+        case OPT_MOMENTUM:
+        case OPT_NESTEROV:
+            plan.learning_rate = 0.3;
+            plan.epochs = 200;
+            plan.optimizer.schedule = LR_COSINE;
+            break;
+        case OPT_ADAM:
+            plan.learning_rate = 0.05;
+            plan.epochs = 150;
+            plan.optimizer.schedule = LR_COSINE;
+            break;
+        default:
+            plan.learning_rate = 0.5;
+            plan.epochs = 1000;
+            break;
+    }
+    return plan;
 }
 
-// Derivada de la función sigmoide
-double sigmoid_derivative(double x) {
-    return x * (1.0 - x);
+// Interpreta las opciones --optimizador, --programa, --tasa y --epocas. El valor de
+// --optimizador toma el plan por defecto de ese optimizador, por eso se aplica antes
+// que las demas; las opciones ausentes (valor vacio) no cambian el plan. Retorna false
+// con el motivo en reason si algun valor no es valido.
+bool parseTrainingPlan(const string& optimizerText, const string& scheduleText, const string& rateText,
+                       const string& epochsText, TrainingPlan& plan, string& reason) {
+    if (!optimizerText.empty()) {
+        int k = OPT_SGD;
+        while (k <= OPT_ADAM && optimizerText != optimizerName((OptimizerKind)k)) k++;
+        if (k > OPT_ADAM) {
+            reason = "optimizador desconocido \"" + optimizerText + "\" (sgd, momentum, nesterov o adam)";
+            return false;
+        }
+        plan = defaultTrainingPlan((OptimizerKind)k);
+    }
+    if (!scheduleText.empty()) {
+        int s = LR_CONSTANT;
+        while (s <= LR_COSINE && scheduleText != scheduleName((LearningRateSchedule)s)) s++;
+        if (s > LR_COSINE) {
+            reason = "programa desconocido \"" + scheduleText + "\" (constante, escalon o coseno)";
+            return false;
+        }
+        plan.optimizer.schedule = (LearningRateSchedule)s;
+    }
+    if (!rateText.empty()) {
+        plan.learning_rate = atof(rateText.c_str());
+        if (!(plan.learning_rate > 0.0 && plan.learning_rate <= 100.0)) {
+            reason = "tasa de aprendizaje invalida \"" + rateText + "\"";
+            return false;
+        }
+    }
+    if (!epochsText.empty()) {
+        plan.epochs = atoi(epochsText.c_str());
+        if (plan.epochs <= 0 || plan.epochs > 10000000) {
+            reason = "numero de epocas invalido \"" + epochsText + "\"";
+            return false;
+        }
+    }
+    return true;
 }
 
-// Función para pausar la ejecución
-void pausar(int milisegundos) {
-    this_thread::sleep_for(chrono::milliseconds(milisegundos));
+// Interpreta --hilos-entrenamiento (ausente = 1) y --hogwild, que aplica pasos de
+// SGD y por eso solo se admite con --optimizador sgd
+bool parseTrainingThreads(const string& threadsText, bool hogwild, TrainingPlan& plan, string& reason) {
+    if (!threadsText.empty()) {
+        plan.threads = atoi(threadsText.c_str());
+        if (plan.threads <= 0 || plan.threads > 1024) {
+            reason = "numero de hilos de entrenamiento invalido \"" + threadsText + "\"";
+            return false;
+        }
+    }
+    if (hogwild && plan.threads < 2) {
+        reason = "--hogwild necesita --hilos-entrenamiento de 2 o mas";
+        return false;
+    }
+    if (hogwild && plan.optimizer.kind != OPT_SGD) {
+        reason = "--hogwild solo admite --optimizador sgd";
+        return false;
+    }
+    plan.hogwild = hogwild;
+    return true;
 }
 
-// Clase para la Red Neuronal
-class NeuralNetwork {
-private:
-    int input_size;
-    int hidden_size;
-    int output_size;
-    
-    vector<vector<double>> weights_input_hidden;
-    vector<vector<double>> weights_hidden_output;
-    vector<double> bias_hidden;
-    vector<double> bias_output;
+// Interpreta --semilla, --validacion (intervalo en epocas; 0 la desactiva),
+// --paciencia y --objetivo (exactitud de validacion en %); los ausentes no cambian
+bool parseValidation(const string& seedText, const string& intervalText, const string& patienceText,
+                     const string& targetText, TrainingPlan& plan, string& reason) {
+    if (!seedText.empty()) {
+        char* end = nullptr;
+        unsigned long seed = strtoul(seedText.c_str(), &end, 10);
+        if (*end != '\0' || seedText[0] == '-' || seed > 0xFFFFFFFFUL) {
+            reason = "semilla invalida \"" + seedText + "\" (entero de 0 a 4294967295)";
+            return false;
+        }
+        plan.seed = (uint32_t)seed;
+    }
+    if (!intervalText.empty()) {
+        plan.eval_interval = atoi(intervalText.c_str());
+        if (plan.eval_interval < 0 || (plan.eval_interval == 0 && intervalText != "0")) {
+            reason = "intervalo de validacion invalido \"" + intervalText + "\"";
+            return false;
+        }
+    }
+    if (!patienceText.empty()) {
+        plan.patience = atoi(patienceText.c_str());
+        if (plan.patience <= 0) {
+            reason = "paciencia invalida \"" + patienceText + "\"";
+            return false;
+        }
+    }
+    if (!targetText.empty()) {
+        plan.target_accuracy = atof(targetText.c_str());
+        if (!(plan.target_accuracy > 0.0 && plan.target_accuracy <= 100.0)) {
+            reason = "objetivo de exactitud invalido \"" + targetText + "\" (porcentaje)";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Configura el optimizador y la tasa de la red segun el plan; los programas se
+// ajustan a plan.epochs (el escalon reduce la tasa cuatro veces)
+template <class Real>
+void applyTrainingPlan(BasicNeuralNetwork<Real>& nn, const TrainingPlan& plan) {
+    OptimizerConfig config = plan.optimizer;
+    config.cosine_epochs = plan.epochs;
+    config.step_epochs = max(1, plan.epochs / 4);
+    nn.setOptimizer(config);
+    nn.setLearningRate(plan.learning_rate);
+    nn.setTrainingThreads(plan.threads, plan.hogwild);
+}
+
+// Descripcion de un plan para los mensajes del programa
+string describeTrainingPlan(const TrainingPlan& plan) {
+    ostringstream text;
+    text << optimizerName(plan.optimizer.kind) << ", tasa " << plan.learning_rate << " ("
+         << scheduleName(plan.optimizer.schedule) << ")";
+    if (plan.hogwild) text << ", " << plan.threads << " hilos (Hogwild)";
+    else if (plan.threads > 1) text << ", " << plan.threads << " hilos";
+    return text.str();
+}
+
+// Conjunto de validacion: digitos de referencia con exactamente 1 pixel invertido, de
+// modo que ninguna muestra repite un digito de entrenamiento (los digitos limpios)
+const int VALIDATION_SAMPLES = 1000;
+const uint32_t VALIDATION_SEED = 777;
+
+// Entrena la red con los digitos de referencia segun el plan, evaluandola sobre el
+// conjunto de validacion cada plan.eval_interval epocas hasta alcanzar el objetivo,
+// una meseta o plan.epochs. progress recibe las epocas hechas y el maximo.
+template <class Real>
+TrainingResult trainNetwork(BasicNeuralNetwork<Real>& nn, const TrainingPlan& plan,
+                            const function<void(int, int)>& progress = nullptr) {
+    applyTrainingPlan(nn, plan);
+    Matrix train_x, train_y, val_x, val_y;
+    buildTrainingSet(train_x, train_y);
+    buildNoisySet(VALIDATION_SAMPLES, 1, VALIDATION_SEED, val_x, val_y, 1);
+    BasicMatrix<Real> inputs, targets, val_inputs, val_targets;
+    convertMatrix(train_x, inputs);
+    convertMatrix(train_y, targets);
+    convertMatrix(val_x, val_inputs);
+    convertMatrix(val_y, val_targets);
+
+    TrainingResult result;
+    result.loss = result.val_loss = result.val_accuracy = 0.0;
+    result.stop = "maximo de epocas";
+    int step = (plan.eval_interval > 0) ? plan.eval_interval : max(1, plan.epochs / 20);
+    double best_loss = 0.0;
+    int stalled = 0;
+    int epoch = 0;
+    while (epoch < plan.epochs) {
+        int n = min(step, plan.epochs - epoch);
+        result.loss = nn.trainBatch(inputs, targets, n, plan.batch_size);
+        epoch += n;
+        if (progress) progress(epoch, plan.epochs);
+        if (plan.eval_interval <= 0) continue;
+
+        nn.evaluate(val_inputs, val_targets, result.val_loss, result.val_accuracy);
+        if (result.val_accuracy >= plan.target_accuracy) {
+            result.stop = "objetivo de validacion";
+            break;
+        }
+        if (epoch == n || result.val_loss < best_loss * (1.0 - plan.min_improvement)) {
+            best_loss = result.val_loss;
+            stalled = 0;
+        } else if (++stalled >= plan.patience) {
+            result.stop = "meseta de validacion";
+            break;
+        }
+    }
+    result.epochs = epoch;
+    return result;
+}
+
+// Carga la red guardada en path si existe, es valida y corresponde a la arquitectura
+// pedida; si no, retorna nullptr con el motivo en reason
+unique_ptr<NeuralNetwork> loadSavedNetwork(const string& path, const NetworkSpec& spec, string& reason) {
+    unique_ptr<NeuralNetwork> nn;
+    try {
+        nn.reset(new NeuralNetwork(path));
+    } catch (const runtime_error& e) {
+        reason = e.what();
+        return nullptr;
+    }
+    if (nn->layerSizes() != spec.sizes || nn->layerActivations() != spec.activations) {
+        NetworkSpec saved;
+        saved.sizes = nn->layerSizes();
+        saved.activations = nn->layerActivations();
+        reason = path + " corresponde a otra arquitectura de red (" + describeArchitecture(saved) + ")";
+        return nullptr;
+    }
+    return nn;
+}
+
+// Motivo por el que el plan obliga a entrenar aunque exista un modelo guardado
+const char* const RETRAIN_REASON = "se indicaron opciones de entrenamiento";
+
+// Red de los modos sin interaccion: el modelo guardado si es valido, tiene la
+// arquitectura pedida y no se pidio un plan de entrenamiento; si no, se entrena con
+// los digitos de referencia y se guarda
+unique_ptr<NeuralNetwork> loadOrTrainNetwork(const NetworkSpec& spec, const TrainingPlan& plan) {
+    string reason;
+    unique_ptr<NeuralNetwork> nn;
+    if (plan.retrain) reason = RETRAIN_REASON;
+    else nn = loadSavedNetwork(MODEL_FILENAME, spec, reason);
+    if (nn) {
+        cout << "[OK] Modelo cargado de " << MODEL_FILENAME << endl;
+        return nn;
+    }
+    if (plan.retrain) cout << "[INFO] Se entrena una red nueva: " << reason << endl;
     
-    double learning_rate;
+    nn.reset(new NeuralNetwork(spec.sizes, spec.activations, plan.learning_rate, plan.seed));
+    TrainingResult result = trainNetwork(*nn, plan);
+    cout << "[OK] Red entrenada: " << result.epochs << " epocas (" << result.stop << ")" << endl;
+    if (!nn->save(MODEL_FILENAME)) {
+        cerr << "[ADVERTENCIA] No se pudo guardar " << MODEL_FILENAME << endl;
+    }
+    return nn;
+}
+
+// Tokenizador de mapas de bits sobre el texto proyectado (sin copias intermedias).
+// Cada caracter '0' o '1' es un pixel y los espacios y saltos de linea solo separan,
+// de modo que se aceptan filas "0 1 1 1 0" y "01110". Cada BITMAP_PIXELS pixeles
+// consecutivos forman un digito; cualquier otro caracter es un error.
+class BitmapParser {
+private:
+    const char* p;
+    const char* end;
+    long long line_number;
+    bool bad_token;
+    bool truncated;
     
 public:
-    NeuralNetwork(int input, int hidden, int output, double lr = 0.1) {
-        input_size = input;
-        hidden_size = hidden;
-        output_size = output;
-        learning_rate = lr;
-        
-        // Inicializar pesos y bias con valores aleatorios
-        random_device rd;
-        mt19937 gen(rd());
-        uniform_real_distribution<> dis(-1.0, 1.0);
-        
-        // Pesos entrada -> oculta
-        weights_input_hidden.resize(input_size, vector<double>(hidden_size));
-        for (int i = 0; i < input_size; i++) {
-            for (int j = 0; j < hidden_size; j++) {
-                weights_input_hidden[i][j] = dis(gen);
+    BitmapParser(const char* data, size_t size)
+        : p(data), end(data + size), line_number(1), bad_token(false), truncated(false) {}
+    
+    // Escribe los pixeles del siguiente digito en pixels; false al final o ante un error
+    bool next(double* pixels) {
+        int n = 0;
+        while (n < BITMAP_PIXELS) {
+            if (p == end) {
+                truncated = (n > 0);
+                return false;
             }
-        }
-        
-        // Pesos oculta -> salida
-        weights_hidden_output.resize(hidden_size, vector<double>(output_size));
-        for (int i = 0; i < hidden_size; i++) {
-            for (int j = 0; j < output_size; j++) {
-                weights_hidden_output[i][j] = dis(gen);
+            char c = *p++;
+            if (c == '0' || c == '1') {
+                pixels[n++] = (double)(c - '0');
+            } else if (c == '\n') {
+                line_number++;
+            } else if (c != ' ' && c != '\t' && c != '\r') {
+                bad_token = true;
+                return false;
             }
         }
-        
-        // Bias
-        bias_hidden.resize(hidden_size);
-        bias_output.resize(output_size);
-        for (int i = 0; i < hidden_size; i++) {
-            bias_hidden[i] = dis(gen);
+        return true;
+    }
+    
+    // Digitos completos que entregara next(): pixeles hasta el primer caracter invalido
+    // dividido por BITMAP_PIXELS. Una pasada sobre el texto sin escribir pixeles.
+    static long long countBitmaps(const char* data, size_t size) {
+        long long pixel_count = 0;
+        for (const char* q = data; q != data + size; q++) {
+            char c = *q;
+            if (c == '0' || c == '1') pixel_count++;
+            else if (c != '\n' && c != ' ' && c != '\t' && c != '\r') break;
         }
-        for (int i = 0; i < output_size; i++) {
-            bias_output[i] = dis(gen);
+        return pixel_count / BITMAP_PIXELS;
+    }
+    
+    bool failed() const { return bad_token; }
+    bool incomplete() const { return truncated; }
+    long long line() const { return line_number; }
+};
+
+// Carga todos los mapas de bits del archivo en bitmaps (un digito por fila).
+// Retorna false si el archivo contiene un caracter invalido; un ultimo digito
+// incompleto se descarta y se informa en incomplete.
+bool loadBitmaps(const MappedFile& file, Matrix& bitmaps, long long& errorLine, bool& incomplete) {
+    // Se cuentan los digitos antes de reservar (con las mismas reglas que next()), asi la
+    // matriz tiene exactamente una fila por digito. El parser escribe en un buffer local y solo se copian digitos
+    // completos, de modo que un digito final incompleto nunca escribe fuera de ella.
+    size_t size = file.data() ? file.size() : 0;
+    bitmaps = Matrix((int)BitmapParser::countBitmaps(file.data(), size), BITMAP_PIXELS);
+    BitmapParser parser(file.data(), size);
+    double pixels[BITMAP_PIXELS];
+    int count = 0;
+    while (parser.next(pixels)) {
+        copy(pixels, pixels + BITMAP_PIXELS, bitmaps.row(count));
+        count++;
+    }
+    bitmaps.resize(count, BITMAP_PIXELS);
+    
+    errorLine = parser.line();
+    incomplete = parser.incomplete();
+    return !parser.failed();
+}
+
+// Dibuja un mapa de bits con '#' y '.' (una fila por linea, con sangria)
+void printBitmap(const double* pixels, const string& indent) {
+    for (int r = 0; r < BITMAP_ROWS; r++) {
+        cout << indent;
+        for (int c = 0; c < BITMAP_COLS; c++) {
+            cout << (pixels[r * BITMAP_COLS + c] > 0.5 ? '#' : '.');
         }
+        cout << endl;
+    }
+}
+
+// Escribe v en [0, 1] con 4 decimales (mas rapido que el formateo de iostream)
+inline char* formatConfidence(double v, char* out) {
+    int scaled = (int)(min(1.0, max(0.0, v)) * 10000.0 + 0.5);
+    *out++ = (char)('0' + scaled / 10000);
+    *out++ = '.';
+    int frac = scaled % 10000;
+    for (int d = 1000; d > 0; d /= 10) {
+        *out++ = (char)('0' + frac / d % 10);
+    }
+    return out;
+}
+
+// Bloque de digitos en proceso y su texto de salida (una porcion por hilo)
+struct InferenceChunk {
+    Matrix inputs;  // Un mapa de bits por fila, escrito directamente por el tokenizador
+    int count;
+    long long base;  // Indice global del primer digito
+    vector<vector<char>> text;
+    vector<size_t> text_len;
+};
+
+// Clasificacion por lotes de archivos grandes: proyecta el archivo en memoria, lee
+// los mapas de bits en bloques, reparte cada bloque entre los hilos (que comparten
+// los pesos de solo lectura) y escribe en salida una linea CSV por digito. Con dos bloques alternados, la lectura
+// del siguiente bloque y la escritura del anterior se solapan con el calculo.
+// Sin pausas ni salida por elemento.
+int runBatchInference(const NeuralNetwork& nn, const string& inputPath, const string& outputPath,
+                      int threads) {
+    const int chunkSize = 1 << 16;
+    const int lineCapacity = 64;  // Caracteres maximos por linea de salida
+    
+    MappedFile file;
+    if (!file.open(inputPath)) {
+        cerr << "[ERROR] No se pudo abrir " << inputPath << endl;
+        return 1;
+    }
+    BitmapParser parser(file.data(), file.size());
+    ofstream out(outputPath.c_str(), ios::binary);
+    if (!out.is_open()) {
+        cerr << "[ERROR] No se pudo crear " << outputPath << endl;
+        return 1;
     }
+    out << "indice,par,impar,primo,compuesto,conf_par,conf_impar,conf_primo,conf_compuesto\n";
     
-    // Propagación hacia adelante
-    vector<double> forward(const vector<double>& input, vector<double>& hidden_layer) {
-        // Capa oculta
-        hidden_layer.resize(hidden_size);
-        for (int j = 0; j < hidden_size; j++) {
-            double sum = bias_hidden[j];
-            for (int i = 0; i < input_size; i++) {
-                sum += input[i] * weights_input_hidden[i][j];
-            }
-            hidden_layer[j] = sigmoid(sum);
+    ThreadPool pool(threads);
+    int workers = pool.size();
+    
+    // Espacios de trabajo por hilo y buffers de los bloques, reservados una sola vez
+    int out_size = nn.outputSize();
+    vector<AlignedVector> scratch_ws(workers, AlignedVector(nn.scratchSize(), 0.0));
+    vector<AlignedVector> output_ws(workers, AlignedVector(out_size, 0.0));
+    
+    InferenceChunk chunks[2];
+    for (int c = 0; c < 2; c++) {
+        chunks[c].inputs = Matrix(chunkSize, BITMAP_PIXELS);
+        chunks[c].text.assign(workers, vector<char>((size_t)chunkSize * lineCapacity / workers + lineCapacity));
+        chunks[c].text_len.assign(workers, 0);
+    }
+    
+    long long total = 0;
+    auto readChunk = [&](InferenceChunk& chunk) {
+        chunk.count = 0;
+        chunk.base = total;
+        while (chunk.count < chunkSize && parser.next(chunk.inputs.row(chunk.count))) {
+            chunk.count++;
         }
+        total += chunk.count;
+    };
+    
+    // Trabajo de los hilos sobre el bloque en curso; vive durante todo el lazo porque
+    // pool.start lo usa por referencia hasta pool.wait()
+    InferenceChunk* running = nullptr;
+    auto chunkJob = [&nn, &running, &scratch_ws, &output_ws](int begin, int end, int w) {
+        InferenceChunk& chunk = *running;
+        double* scratch = &scratch_ws[w][0];
+        double* output = &output_ws[w][0];
+        char* p = &chunk.text[w][0];
         
-        // Capa de salida
-        vector<double> output(output_size);
-        for (int j = 0; j < output_size; j++) {
-            double sum = bias_output[j];
-            for (int i = 0; i < hidden_size; i++) {
-                sum += hidden_layer[i] * weights_hidden_output[i][j];
+        for (int i = begin; i < end; i++) {
+            nn.predictInto(chunk.inputs.row(i), output, scratch);
+            
+            p += sprintf(p, "%lld,", chunk.base + i);
+            for (int c = 0; c < 4; c++) {
+                *p++ = output[c] > 0.5 ? '1' : '0';
+                *p++ = ',';
+            }
+            for (int c = 0; c < 4; c++) {
+                p = formatConfidence(output[c], p);
+                *p++ = (c < 3) ? ',' : '\n';
             }
-            output[j] = sigmoid(sum);
         }
+        chunk.text_len[w] = p - &chunk.text[w][0];
+    };
+    auto startChunk = [&](InferenceChunk& chunk) {
+        running = &chunk;
+        pool.start(chunk.count, chunkJob);
+    };
+    
+    auto start = chrono::steady_clock::now();
+    
+    int cur = 0;
+    readChunk(chunks[cur]);
+    if (chunks[cur].count > 0) startChunk(chunks[cur]);
+    while (chunks[cur].count > 0) {
+        InferenceChunk& next = chunks[1 - cur];
+        readChunk(next);
+        pool.wait();
+        if (next.count > 0) startChunk(next);
         
-        return output;
+        // Los bloques de cada hilo son contiguos y en orden: se escriben tal cual
+        InferenceChunk& done = chunks[cur];
+        for (int w = 0; w < workers; w++) {
+            out.write(&done.text[w][0], done.text_len[w]);
+            done.text_len[w] = 0;
+        }
+        cur = 1 - cur;
     }
+    out.close();
     
-    // Entrenamiento con backpropagation
-    void train(const vector<double>& input, const vector<double>& target, int epochs) {
-        for (int epoch = 0; epoch < epochs; epoch++) {
-            vector<double> hidden_layer;
-            vector<double> output = forward(input, hidden_layer);
-            
-            // Calcular error en la salida
-            vector<double> output_error(output_size);
-            vector<double> output_delta(output_size);
-            for (int i = 0; i < output_size; i++) {
-                output_error[i] = target[i] - output[i];
-                output_delta[i] = output_error[i] * sigmoid_derivative(output[i]);
-            }
-            
-            // Calcular error en la capa oculta
-            vector<double> hidden_error(hidden_size);
-            vector<double> hidden_delta(hidden_size);
-            for (int i = 0; i < hidden_size; i++) {
-                hidden_error[i] = 0.0;
-                for (int j = 0; j < output_size; j++) {
-                    hidden_error[i] += output_delta[j] * weights_hidden_output[i][j];
-                }
-                hidden_delta[i] = hidden_error[i] * sigmoid_derivative(hidden_layer[i]);
-            }
-            
-            // Actualizar pesos oculta -> salida
-            for (int i = 0; i < hidden_size; i++) {
-                for (int j = 0; j < output_size; j++) {
-                    weights_hidden_output[i][j] += learning_rate * output_delta[j] * hidden_layer[i];
-                }
-            }
-            
-            // Actualizar bias de salida
-            for (int i = 0; i < output_size; i++) {
-                bias_output[i] += learning_rate * output_delta[i];
-            }
-            
-            // Actualizar pesos entrada -> oculta
-            for (int i = 0; i < input_size; i++) {
-                for (int j = 0; j < hidden_size; j++) {
-                    weights_input_hidden[i][j] += learning_rate * hidden_delta[j] * input[i];
-                }
+    if (parser.failed()) {
+        cerr << "[ERROR] Caracter invalido en la linea " << parser.line() << " de " << inputPath
+             << " (se clasificaron los " << total << " digitos anteriores)" << endl;
+        return 1;
+    }
+    if (parser.incomplete()) {
+        cerr << "[ADVERTENCIA] El ultimo mapa de bits esta incompleto - IGNORADO" << endl;
+    }
+    
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "[OK] Digitos clasificados: " << total << endl;
+    cout << "[OK] Hilos: " << workers << ", tiempo: " << fixed << setprecision(3) << seconds << " s, "
+         << setprecision(0) << (seconds > 0 ? total / seconds : 0.0) << " digitos/s" << endl;
+    cout << "[OK] Resultados en: " << outputPath << endl;
+    return 0;
+}
+
+// Resultado de una variante de precision en runPrecisionReport
+struct PrecisionResult {
+    double accuracy;   // Muestras con las 4 clases correctas
+    double agreement;  // Muestras con las mismas 4 decisiones que la red double
+    double max_error;  // Maxima diferencia absoluta de salida respecto a la red double
+    double rate;       // Predicciones por segundo
+    size_t bytes;      // Memoria de los parametros
+};
+
+// Mide una variante de inferencia sobre inputs: primero el rendimiento (pasadas
+// completas durante al menos 0.2 s) y luego la exactitud contra targets y las salidas
+// de referencia de la red double
+template <class Net, class T>
+PrecisionResult evaluatePrecision(Net& net, const BasicMatrix<T>& inputs, const Matrix& targets,
+                                  const Matrix& reference) {
+    PrecisionResult result;
+    vector<T> output(net.outputSize());
+    
+    long long predictions = 0;
+    double seconds = 0.0;
+    auto start = chrono::steady_clock::now();
+    while (seconds < 0.2) {
+        for (int i = 0; i < inputs.rows; i++) net.predictInto(inputs.row(i), &output[0]);
+        predictions += inputs.rows;
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    result.rate = predictions / seconds;
+    
+    int correct = 0, agree = 0;
+    result.max_error = 0.0;
+    for (int i = 0; i < inputs.rows; i++) {
+        net.predictInto(inputs.row(i), &output[0]);
+        bool ok = true, same = true;
+        for (int c = 0; c < targets.cols; c++) {
+            bool decision = output[c] > T(0.5);
+            ok = ok && (decision == (targets(i, c) > 0.5));
+            same = same && (decision == (reference(i, c) > 0.5));
+            result.max_error = max(result.max_error, fabs((double)output[c] - reference(i, c)));
+        }
+        correct += ok;
+        agree += same;
+    }
+    result.accuracy = 100.0 * correct / inputs.rows;
+    result.agreement = 100.0 * agree / inputs.rows;
+    result.bytes = net.parameterBytes();
+    return result;
+}
+
+// Reporte de precision reducida: compara la red double (referencia) con la misma red
+// convertida a float, una red entrenada en float y la red cuantizada a int8, sobre
+// digitos de referencia con hasta 2 pixeles invertidos
+int runPrecisionReport(NeuralNetwork& nn, const TrainingPlan& plan, int samples) {
+    Matrix inputs, targets;
+    buildNoisySet(samples, 2, 12345, inputs, targets);
+    BasicMatrix<float> inputs_f;
+    convertMatrix(inputs, inputs_f);
+    
+    Matrix reference(samples, nn.outputSize());
+    for (int i = 0; i < samples; i++) nn.predictInto(inputs.row(i), reference.row(i));
+    
+    BasicNeuralNetwork<float> converted(nn);
+    
+    BasicNeuralNetwork<float> trained(nn.layerSizes(), nn.layerActivations(), plan.learning_rate, plan.seed);
+    trainNetwork(trained, plan);
+    
+    QuantizedNetwork quantized(nn);
+    
+    const char* names[] = {"double", "float (convertida)", "float (entrenada)", "int8"};
+    PrecisionResult results[4];
+    results[0] = evaluatePrecision(nn, inputs, targets, reference);
+    results[1] = evaluatePrecision(converted, inputs_f, targets, reference);
+    results[2] = evaluatePrecision(trained, inputs_f, targets, reference);
+    results[3] = evaluatePrecision(quantized, inputs_f, targets, reference);
+    
+    cout << "Muestras: " << samples << " (digitos de referencia con 0-2 pixeles invertidos)" << endl;
+    cout << left << setw(20) << "Precision" << right << setw(11) << "Exactitud" << setw(11) << "Coincide"
+         << setw(12) << "Max |dif|" << setw(11) << "Pesos (B)" << setw(14) << "Pred/s" << setw(9) << "Acel."
+         << endl;
+    for (int v = 0; v < 4; v++) {
+        const PrecisionResult& r = results[v];
+        cout << left << setw(20) << names[v] << right << fixed << setprecision(2)
+             << setw(10) << r.accuracy << "%" << setw(10) << r.agreement << "%"
+             << setw(12) << scientific << setprecision(2) << r.max_error << fixed
+             << setw(11) << r.bytes << setw(14) << setprecision(0) << r.rate
+             << setw(8) << setprecision(2) << r.rate / results[0].rate << "x" << endl;
+    }
+    return 0;
+}
+
+// Comparacion de optimizadores: entrena runs redes con el plan por defecto de cada
+// optimizador y muestra las epocas hasta que el error cuadratico medio baja de
+// target_loss, el tiempo de entrenamiento y la exactitud final sobre digitos con
+// 0-2 pixeles invertidos (promedios de las redes, con semillas seed, seed + 1, ...)
+int runOptimizerReport(const NetworkSpec& spec, uint32_t seed, int runs) {
+    const double target_loss = 0.005;
+    Matrix inputs, targets;
+    buildTrainingSet(inputs, targets);
+    Matrix noisy_x, noisy_y;
+    buildNoisySet(10000, 2, 12345, noisy_x, noisy_y);
+
+    cout << "Arquitectura: " << describeArchitecture(spec) << ", " << runs << " redes por optimizador (semilla "
+         << seed << "), objetivo "
+         << scientific << setprecision(0) << target_loss << fixed << endl;
+    cout << left << setw(10) << "Optimiz." << right << setw(7) << "Tasa" << setw(11) << "Programa"
+         << setw(8) << "Epocas" << setw(13) << "Al objetivo" << setw(11) << "Logrado" << setw(10) << "ms"
+         << setw(11) << "Exactitud" << endl;
+    for (int k = OPT_SGD; k <= OPT_ADAM; k++) {
+        TrainingPlan plan = defaultTrainingPlan((OptimizerKind)k);
+        double epochs_to_target = 0.0, ms = 0.0, accuracy = 0.0;
+        int reached = 0;
+        for (int r = 0; r < runs; r++) {
+            NeuralNetwork nn(spec.sizes, spec.activations, plan.learning_rate, seed + r);
+            applyTrainingPlan(nn, plan);
+            auto start = chrono::steady_clock::now();
+            int first = 0;
+            for (int epoch = 1; epoch <= plan.epochs; epoch++) {
+                double loss = nn.trainBatch(inputs, targets, 1, plan.batch_size);
+                if (first == 0 && loss < target_loss) first = epoch;
             }
-            
-            // Actualizar bias oculta
-            for (int i = 0; i < hidden_size; i++) {
-                bias_hidden[i] += learning_rate * hidden_delta[i];
+            ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            if (first > 0) {
+                reached++;
+                epochs_to_target += first;
             }
+            accuracy += evaluatePrecision(nn, noisy_x, noisy_y, noisy_y).accuracy;
         }
+        cout << left << setw(10) << optimizerName(plan.optimizer.kind) << right << setw(7) << setprecision(2)
+             << plan.learning_rate << setw(11) << scheduleName(plan.optimizer.schedule) << setw(8) << plan.epochs
+             << setw(13) << setprecision(1) << (reached > 0 ? epochs_to_target / reached : 0.0)
+             << setw(7) << reached << "/" << left << setw(3) << runs << right << setw(10) << setprecision(2)
+             << ms / runs << setw(10) << accuracy / runs << "%" << endl;
     }
+    return 0;
+}
+
+// Verificacion de sigmoidKernel: error maximo respecto a la sigmoide exacta en double
+// sobre [-50, 50] y tiempo por elemento de cada precision, en double y en float
+template <class T>
+void reportSigmoid(const char* typeName) {
+    const int count = 1 << 20;
+    BasicAlignedVector<T> x(count), y(count);
+    for (int i = 0; i < count; i++) x[i] = T(-50.0 + 100.0 * i / (count - 1));
     
-    // Predecir
-    vector<double> predict(const vector<double>& input) {
-        vector<double> hidden_layer;
-        return forward(input, hidden_layer);
+    const char* names[] = {"exacta", "rapida", "muy rapida"};
+    for (int a = SIGMOID_EXACT; a <= SIGMOID_FASTEST; a++) {
+        double seconds = 0.0;
+        int passes = 0;
+        auto start = chrono::steady_clock::now();
+        while (seconds < 0.2) {
+            copy(x.begin(), x.end(), y.begin());
+            sigmoidKernel(&y[0], count, (SigmoidAccuracy)a);
+            passes++;
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        
+        double max_error = 0.0;
+        for (int i = 0; i < count; i++) {
+            max_error = max(max_error, fabs((double)y[i] - sigmoid((double)x[i])));
+        }
+        cout << left << setw(8) << typeName << setw(12) << names[a] << right
+             << setw(12) << scientific << setprecision(2) << max_error << fixed
+             << setw(10) << setprecision(2) << seconds * 1e9 / ((double)passes * count) << endl;
     }
+}
+
+#ifdef NN_BENCHMARK
+// Benchmark de la red (compilar con -DNN_BENCHMARK). Mide forward, predict y
+// predictInto por muestra, train por muestra y trainBatch por lote para varios
+// tamanos de capa oculta y de lote, sin pausas ni salida por paso. Reporta muestras
+// por segundo, GFLOP/s (multiplicaciones y sumas de los productos densos; las
+// activaciones no se cuentan) y asignaciones de memoria por llamada, medidas despues
+// de una llamada de calentamiento.
+
+typedef chrono::steady_clock BenchClock;
+
+volatile double bench_sink = 0.0;  // Evita que el compilador elimine el trabajo medido
+
+struct BenchResult {
+    string name;
+    int hidden;
+    int batch;               // 0 en las operaciones por muestra
+    double samples_per_s;
+    double gflops;
+    double allocs_per_call;
 };
 
-// Función para convertir número a vector de entrada (codificación one-hot)
-vector<double> numberToInput(int number) {
-    vector<double> input(10, 0.0);
-    input[number] = 1.0;
-    return input;
+// Repite call, que procesa samples muestras, hasta acumular min_seconds
+template <class Call>
+BenchResult benchmarkCall(const string& name, int hidden, int batch, int samples, double flops_per_sample,
+                          double min_seconds, Call call) {
+    call();
+
+    long long calls = 0;
+    long long allocs = nn_allocations;
+    BenchClock::time_point t0 = BenchClock::now();
+    double seconds = 0.0;
+    do {
+        call();
+        calls++;
+        seconds = chrono::duration<double>(BenchClock::now() - t0).count();
+    } while (seconds < min_seconds);
+    allocs = nn_allocations - allocs;
+
+    BenchResult r;
+    r.name = name;
+    r.hidden = hidden;
+    r.batch = batch;
+    r.samples_per_s = (double)calls * samples / seconds;
+    r.gflops = r.samples_per_s * flops_per_sample * 1e-9;
+    r.allocs_per_call = (double)allocs / calls;
+    return r;
 }
 
-// Función para determinar las clases de un número
-vector<double> getClasses(int number) {
-    vector<double> classes(4, 0.0);
-    
-    // Clase 0: Números pares (0, 2, 4, 6, 8)
-    if (number % 2 == 0) {
-        classes[0] = 1.0;
+int main(int argc, char* argv[]) {
+    double min_seconds = 0.2;
+    bool csv = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--csv") csv = true;
+        else min_seconds = max(0.01, atof(argv[i]));
     }
-    
-    // Clase 1: Números impares (1, 3, 5, 7, 9)
-    if (number % 2 != 0) {
-        classes[1] = 1.0;
+
+    const int hiddenSizes[] = {8, 32, 128, 512};
+    const int batchSizes[] = {1, 8, 32, 128};
+    const int samples = 1024;
+    Matrix inputs, targets;
+    buildNoisySet(samples, 2, 12345, inputs, targets);
+    vector<double> input(inputs.row(0), inputs.row(0) + BITMAP_PIXELS);
+    vector<double> target(targets.row(0), targets.row(0) + 4);
+
+    vector<BenchResult> results;
+    for (int h = 0; h < 4; h++) {
+        int hidden = hiddenSizes[h];
+        NeuralNetwork nn(BITMAP_PIXELS, hidden, 4, 0.1);
+
+        // Productos por muestra de las dos capas: la propagacion hace uno por peso; el
+        // entrenamiento ademas el gradiente de los pesos y el delta de la capa oculta
+        double weights = (double)BITMAP_PIXELS * hidden + (double)hidden * 4;
+        double forward_flops = 2.0 * weights;
+        double train_flops = forward_flops + 2.0 * weights + 2.0 * hidden * 4;
+
+        vector<double> hidden_out;
+        vector<double> output(4);
+        int k = 0;
+        results.push_back(benchmarkCall("forward", hidden, 0, 1, forward_flops, min_seconds, [&] {
+            vector<double> y = nn.forward(input, hidden_out);
+            bench_sink = y[0];
+        }));
+        results.push_back(benchmarkCall("predict", hidden, 0, 1, forward_flops, min_seconds, [&] {
+            bench_sink = nn.predict(input)[0];
+        }));
+        results.push_back(benchmarkCall("predictInto", hidden, 0, 1, forward_flops, min_seconds, [&] {
+            nn.predictInto(inputs.row(k), &output[0]);
+            k = (k + 1) % samples;
+            bench_sink = output[0];
+        }));
+        results.push_back(benchmarkCall("train", hidden, 0, 1, train_flops, min_seconds, [&] {
+            nn.train(input, target, 1);
+        }));
+        for (int b = 0; b < 4; b++) {
+            results.push_back(benchmarkCall("trainBatch", hidden, batchSizes[b], samples, train_flops,
+                                            min_seconds, [&] {
+                bench_sink = nn.trainBatch(inputs, targets, 1, batchSizes[b]);
+            }));
+        }
     }
-    
-    // Clase 2: Números primos (2, 3, 5, 7)
-    if (number == 2 || number == 3 || number == 5 || number == 7) {
-        classes[2] = 1.0;
+
+    if (csv) {
+        cout << "operacion,oculta,lote,muestras_por_s,gflops,asignaciones_por_llamada" << endl;
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            cout << r.name << "," << r.hidden << "," << r.batch << "," << fixed << setprecision(0)
+                 << r.samples_per_s << "," << setprecision(3) << r.gflops << "," << setprecision(2)
+                 << r.allocs_per_call << endl;
+        }
+        return 0;
     }
-    
-    // Clase 3: Números compuestos (4, 6, 8, 9)
-    if (number == 4 || number == 6 || number == 8 || number == 9) {
-        classes[3] = 1.0;
+
+    cout << "\n+============================================================+" << endl;
+    cout << "|        BENCHMARK DE LA RED NEURONAL                        |" << endl;
+    cout << "+============================================================+" << endl;
+    cout << "- Red: " << BITMAP_PIXELS << " -> oculta (sigmoide) -> 4, double" << endl;
+    cout << "- Lotes sobre " << samples << " muestras, " << fixed << setprecision(2) << min_seconds
+         << " s por caso\n" << endl;
+
+    cout << left << setw(14) << "Operacion" << right << setw(8) << "Oculta" << setw(7) << "Lote"
+         << setw(15) << "Muestras/s" << setw(10) << "GFLOP/s" << setw(14) << "Asig./llamada" << endl;
+    cout << string(68, '-') << endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        cout << left << setw(14) << r.name << right << setw(8) << r.hidden << setw(7)
+             << (r.batch > 0 ? to_string(r.batch) : string("-")) << fixed << setprecision(0)
+             << setw(15) << r.samples_per_s << setprecision(3) << setw(10) << r.gflops
+             << setprecision(2) << setw(14) << r.allocs_per_call << endl;
     }
-    
-    return classes;
+    cout << endl;
+    return 0;
 }
 
-// Función para obtener el nombre de la clase
-string getClassName(int classIndex) {
-    switch(classIndex) {
-        case 0: return "Numeros pares";
-        case 1: return "Numeros impares";
-        case 2: return "Numeros primos";
-        case 3: return "Numeros compuestos";
-        default: return "Desconocido";
+#else
+
+// Quita de los argumentos la opcion name y su valor, si esta; retorna su valor o ""
+string takeOption(int& argc, char* argv[], const char* name) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) != name) continue;
+        string value = argv[i + 1];
+        for (int j = i; j + 2 <= argc; j++) argv[j] = argv[j + 2];
+        argc -= 2;
+        return value;
     }
+    return "";
 }
 
-// Función para mostrar barra de progreso
-void mostrarProgreso(int actual, int total, string mensaje) {
-    int barWidth = 50;
-    float progreso = (float)actual / total;
-    int pos = barWidth * progreso;
-    
-    cout << "\r" << mensaje << " [";
-    for (int i = 0; i < barWidth; ++i) {
-        if (i < pos) cout << "=";
-        else if (i == pos) cout << ">";
-        else cout << " ";
+// Quita de los argumentos la opcion sin valor name, si esta; retorna si estaba
+bool takeFlag(int& argc, char* argv[], const char* name) {
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) != name) continue;
+        for (int j = i; j + 1 <= argc; j++) argv[j] = argv[j + 1];
+        argc--;
+        return true;
     }
-    cout << "] " << int(progreso * 100.0) << "% (" << actual << "/" << total << ")";
-    cout.flush();
+    return false;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     // Configurar consola para caracteres especiales
     SetConsoleOutputCP(CP_UTF8);
     
+    // Arquitectura de la red (--capas "neuronas:activacion,...") y plan de
+    // entrenamiento (--optimizador, --programa, --tasa, --epocas, --hilos-entrenamiento,
+    // --hogwild, --semilla, --validacion, --paciencia, --objetivo) en cualquier modo;
+    // se quitan de los argumentos antes de interpretar el resto
+    NetworkSpec spec = defaultArchitecture();
+    TrainingPlan plan = defaultTrainingPlan();
+    string layersText = takeOption(argc, argv, "--capas");
+    string optimizerText = takeOption(argc, argv, "--optimizador");
+    string scheduleText = takeOption(argc, argv, "--programa");
+    string rateText = takeOption(argc, argv, "--tasa");
+    string epochsText = takeOption(argc, argv, "--epocas");
+    string trainThreadsText = takeOption(argc, argv, "--hilos-entrenamiento");
+    bool hogwild = takeFlag(argc, argv, "--hogwild");
+    string seedText = takeOption(argc, argv, "--semilla");
+    string intervalText = takeOption(argc, argv, "--validacion");
+    string patienceText = takeOption(argc, argv, "--paciencia");
+    string targetText = takeOption(argc, argv, "--objetivo");
+    string optionError;
+    if (!layersText.empty() && !parseArchitecture(layersText, spec, optionError)) {
+        cerr << "[ERROR] --capas " << layersText << ": " << optionError << endl;
+        return 1;
+    }
+    if (!parseTrainingPlan(optimizerText, scheduleText, rateText, epochsText, plan, optionError) ||
+        !parseTrainingThreads(trainThreadsText, hogwild, plan, optionError) ||
+        !parseValidation(seedText, intervalText, patienceText, targetText, plan, optionError)) {
+        cerr << "[ERROR] " << optionError << endl;
+        return 1;
+    }
+    // Con cualquier opcion de entrenamiento el modelo guardado (entrenado con otro plan)
+    // no se reutiliza: se entrena y se guarda uno nuevo
+    plan.retrain = !optimizerText.empty() || !scheduleText.empty() || !rateText.empty() ||
+                   !epochsText.empty() || !trainThreadsText.empty() || hogwild ||
+                   !seedText.empty() || !intervalText.empty() || !patienceText.empty() ||
+                   !targetText.empty();
+    
+    // Modo por lotes: clasificador --batch entrada.txt salida.csv [hilos]
+    if (argc >= 4 && string(argv[1]) == "--batch") {
+        int threads = (argc >= 5) ? atoi(argv[4]) : (int)thread::hardware_concurrency();
+        
+        unique_ptr<NeuralNetwork> nn = loadOrTrainNetwork(spec, plan);
+        return runBatchInference(*nn, argv[2], argv[3], threads);
+    }
+    
+    // Reporte de precision: clasificador --precision [muestras]
+    if (argc >= 2 && string(argv[1]) == "--precision") {
+        int samples = (argc >= 3) ? atoi(argv[2]) : 100000;
+        unique_ptr<NeuralNetwork> nn = loadOrTrainNetwork(spec, plan);
+        return runPrecisionReport(*nn, plan, max(10, samples));
+    }
+    
+    // Comparacion de optimizadores: clasificador --optimizadores [redes]
+    if (argc >= 2 && string(argv[1]) == "--optimizadores") {
+        int runs = (argc >= 3) ? atoi(argv[2]) : 10;
+        return runOptimizerReport(spec, plan.seed, max(1, runs));
+    }
+    
+    // Verificacion de la sigmoide vectorizada: clasificador --sigmoid
+    if (argc >= 2 && string(argv[1]) == "--sigmoid") {
+        cout << left << setw(8) << "Tipo" << setw(12) << "Sigmoide" << right << setw(12) << "Error max"
+             << setw(10) << "ns/elem" << endl;
+        reportSigmoid<double>("double");
+        reportSigmoid<float>("float");
+        return 0;
+    }
+    
     cout << "=================================================================" << endl;
     cout << "    RED NEURONAL ARTIFICIAL - CLASIFICACION DE NUMEROS" << endl;
     cout << "=================================================================" << endl;
@@ -245,11 +2728,21 @@ int main() {
     cout << "=================================================================" << endl;
     cout << "    CONFIGURACION DE LA RED NEURONAL" << endl;
     cout << "=================================================================" << endl;
-    cout << "  * Capa de entrada:  10 neuronas (codificacion one-hot)" << endl;
-    cout << "  * Capa oculta:       8 neuronas (funcion sigmoide)" << endl;
-    cout << "  * Capa de salida:    4 neuronas (4 clases)" << endl;
-    cout << "  * Tasa de aprendizaje: 0.5" << endl;
-    cout << "  * Epocas por numero:   1000" << endl;
+    cout << "  * Capa de entrada:  35 neuronas (mapa de bits de 5x7)" << endl;
+    for (size_t l = 0; l < spec.activations.size(); l++) {
+        bool output = (l + 1 == spec.activations.size());
+        cout << "  * Capa " << (output ? "de salida:  " : "oculta:     ") << setw(3) << spec.sizes[l + 1]
+             << " neuronas (" << (output ? "4 clases, " : "") << "funcion "
+             << activationName(spec.activations[l]) << ")" << endl;
+    }
+    cout << "  * Optimizador:         " << describeTrainingPlan(plan) << endl;
+    cout << "  * Epocas:              hasta " << plan.epochs << " (mini-lotes de " << plan.batch_size
+         << ", barajados)" << endl;
+    if (plan.eval_interval > 0) {
+        cout << "  * Parada temprana:     cada " << plan.eval_interval << " epocas, objetivo "
+             << plan.target_accuracy << "% o " << plan.patience << " evaluaciones sin mejora" << endl;
+    }
+    cout << "  * Semilla:             " << plan.seed << endl;
     cout << "=================================================================" << endl << endl;
     
     pausar(500);
@@ -266,30 +2759,52 @@ int main() {
     
     pausar(800);
     
-    // Crear red neuronal
+    // Cargar el modelo guardado o crear una red nueva
     cout << "[ETAPA 1] Inicializando red neuronal..." << endl;
-    NeuralNetwork nn(10, 8, 4, 0.5);
-    cout << "[OK] Red neuronal creada exitosamente." << endl << endl;
+    auto loadStart = chrono::steady_clock::now();
+    string reason;
+    unique_ptr<NeuralNetwork> nn;
+    if (plan.retrain) reason = RETRAIN_REASON;
+    else nn = loadSavedNetwork(MODEL_FILENAME, spec, reason);
+    bool loaded = (nn != nullptr);
+    if (loaded) {
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count();
+        cout << "[OK] Modelo entrenado cargado de " << MODEL_FILENAME << " en " << fixed
+             << setprecision(3) << ms << " ms." << endl << endl;
+    } else {
+        cout << "  [INFO] " << (plan.retrain ? "Se entrena una red nueva: " : "Sin modelo guardado: ")
+             << reason << endl;
+        nn.reset(new NeuralNetwork(spec.sizes, spec.activations, plan.learning_rate, plan.seed));
+        cout << "[OK] Red neuronal creada exitosamente." << endl << endl;
+    }
     
     pausar(300);
     
-    // Entrenar la red
-    cout << "[ETAPA 2] Iniciando entrenamiento de la red neuronal..." << endl << endl;
-    
-    for (int i = 0; i < 10; i++) {
-        vector<double> input = numberToInput(i);
-        vector<double> target = getClasses(i);
-        
-        cout << "  Entrenando numero " << i << "...";
-        cout.flush();
+    // Entrenar la red (solo si no se cargo un modelo)
+    if (loaded) {
+        cout << "[ETAPA 2] Se omite el entrenamiento (modelo cargado)." << endl << endl;
+    } else {
+        cout << "[ETAPA 2] Iniciando entrenamiento de la red neuronal..." << endl << endl;
         
-        nn.train(input, target, 1000);
+        TrainingResult result = trainNetwork(*nn, plan, [](int done, int total) {
+            mostrarProgreso(done, total, "  Entrenando");
+        });
+        cout << endl << "  Epocas: " << result.epochs << " de " << plan.epochs << " (" << result.stop << ")"
+             << endl;
+        cout << "  Error cuadratico medio final: " << scientific << setprecision(3) << result.loss << fixed
+             << endl;
+        if (plan.eval_interval > 0) {
+            cout << "  Validacion: error " << scientific << setprecision(3) << result.val_loss << fixed
+                 << ", exactitud " << setprecision(1) << result.val_accuracy << "%" << endl;
+        }
         
-        cout << " [COMPLETADO]" << endl;
-        pausar(100);
+        cout << "\n[OK] Entrenamiento completado exitosamente." << endl;
+        if (nn->save(MODEL_FILENAME)) {
+            cout << "[OK] Modelo guardado en " << MODEL_FILENAME << endl << endl;
+        } else {
+            cerr << "[ADVERTENCIA] No se pudo guardar " << MODEL_FILENAME << endl << endl;
+        }
     }
-    
-    cout << "\n[OK] Entrenamiento completado exitosamente." << endl << endl;
     pausar(500);
     
     // Intentar abrir el archivo
@@ -303,7 +2818,7 @@ int main() {
         "C:\\Users\\cesar\\Desktop\\TP4_C1\\digitos.txt"
     };
     
-    ifstream file;
+    MappedFile file;
     bool fileOpened = false;
     string usedFilename;
     
@@ -312,8 +2827,7 @@ int main() {
         cout.flush();
         pausar(200);
         
-        file.open(filename);
-        if (file.is_open()) {
+        if (file.open(filename)) {
             fileOpened = true;
             usedFilename = filename;
             cout << " [ENCONTRADO]" << endl;
@@ -337,7 +2851,12 @@ int main() {
             ofstream outFile("digitos.txt");
             if (outFile.is_open()) {
                 for (int i = 0; i <= 9; i++) {
-                    outFile << i << endl;
+                    for (int r = 0; r < BITMAP_ROWS; r++) {
+                        for (int c = 0; c < BITMAP_COLS; c++) {
+                            outFile << DIGIT_GLYPHS[i][r][c] << (c < BITMAP_COLS - 1 ? " " : "");
+                        }
+                        outFile << endl;
+                    }
                 }
                 outFile.close();
                 cout << "[OK] Archivo digitos.txt creado exitosamente." << endl;
@@ -357,43 +2876,47 @@ int main() {
     pausar(300);
     
     // Leer y contar números primero
-    cout << "[ETAPA 4] Leyendo numeros del archivo..." << endl;
-    vector<int> numeros;
-    int number;
-    
-    while (file >> number) {
-        if (number >= 0 && number <= 9) {
-            numeros.push_back(number);
-            cout << "  Numero leido: " << number << endl;
-            pausar(100);
-        } else {
-            cout << "  [ADVERTENCIA] Numero " << number << " fuera de rango [0-9] - IGNORADO" << endl;
-        }
-    }
-    
+    cout << "[ETAPA 4] Leyendo mapas de bits de 5x7 del archivo..." << endl;
+    Matrix digitos;
+    long long errorLine;
+    bool incomplete;
+    bool valid = loadBitmaps(file, digitos, errorLine, incomplete);
     file.close();
     
-    cout << "\n[OK] Total de numeros validos leidos: " << numeros.size() << endl << endl;
+    for (int idx = 0; idx < digitos.rows; idx++) {
+        int ref = matchDigit(digitos.row(idx));
+        cout << "  Digito leido " << (idx + 1) << ": ";
+        if (ref >= 0) cout << "coincide con el " << ref << endl;
+        else cout << "sin referencia exacta" << endl;
+        pausar(100);
+    }
+    if (!valid) {
+        cout << "  [ADVERTENCIA] Caracter invalido en la linea " << errorLine
+             << " - se ignora el resto del archivo" << endl;
+    } else if (incomplete) {
+        cout << "  [ADVERTENCIA] El ultimo mapa de bits esta incompleto - IGNORADO" << endl;
+    }
+    
+    cout << "\n[OK] Total de digitos validos leidos: " << digitos.rows << endl << endl;
     pausar(500);
     
     // Clasificar números
     cout << "=================================================================" << endl;
-    cout << "[ETAPA 5] CLASIFICACION DE NUMEROS" << endl;
+    cout << "[ETAPA 5] CLASIFICACION DE DIGITOS" << endl;
     cout << "=================================================================" << endl << endl;
     
-    for (size_t idx = 0; idx < numeros.size(); idx++) {
-        int num = numeros[idx];
-        
+    vector<double> output(4);
+    for (int idx = 0; idx < digitos.rows; idx++) {
         cout << "-----------------------------------------------------------" << endl;
-        cout << "  NUMERO " << (idx + 1) << " de " << numeros.size() << ": " << num << endl;
+        cout << "  DIGITO " << (idx + 1) << " de " << digitos.rows << ":" << endl;
         cout << "-----------------------------------------------------------" << endl;
-        
-        vector<double> input = numberToInput(num);
+        printBitmap(digitos.row(idx), "      ");
+        cout << endl;
         
         cout << "  > Procesando entrada en la red neuronal..." << endl;
         pausar(150);
         
-        vector<double> output = nn.predict(input);
+        nn->predictInto(digitos.row(idx), &output[0]);
         
         cout << "  > Analizando salidas de la red..." << endl;
         pausar(150);
@@ -426,7 +2949,7 @@ int main() {
     cout << "=================================================================" << endl;
     cout << "    RESUMEN FINAL" << endl;
     cout << "=================================================================" << endl;
-    cout << "  Total de numeros procesados: " << numeros.size() << endl;
+    cout << "  Total de digitos procesados: " << digitos.rows << endl;
     cout << "  Archivo procesado: " << usedFilename << endl;
     cout << "  Estado: COMPLETADO EXITOSAMENTE" << endl;
     cout << "=================================================================" << endl << endl;
@@ -437,3 +2960,5 @@ int main() {
     
     return 0;
 }
+
+#endif
\ No newline at end of file